@@ -18,7 +18,7 @@ XCB_CFLAGS  := $(shell pkg-config --cflags $(XCB_MODULES))
 XCB_LDFLAGS := $(shell pkg-config --libs   $(XCB_MODULES))
 
 CPPFLAGS    := -DVERSION=\"$(VERSION)\" -iquotesrc
-CXXFLAGS    := -fpic -fno-rtti -pedantic -std=c++11
+CXXFLAGS    := -fpic -fno-rtti -pedantic -std=c++11 -pthread
 WFLAGS      := -Werror -Wextra -Wall -Wno-long-long -Wundef           \
                -Wredundant-decls -Wshadow -Wsign-compare              \
                -Wmissing-field-initializers -Wno-format-zero-length   \
@@ -26,7 +26,7 @@ WFLAGS      := -Werror -Wextra -Wall -Wno-long-long -Wundef           \
                -Wctor-dtor-privacy -Wnon-virtual-dtor
 AR          := ar
 ARFLAGS     := csr
-LDFLAGS     :=
+LDFLAGS     := -pthread
 
 ifeq ($(COMPILER),gnu)
   CXX := g++
@@ -206,20 +206,28 @@ endef
 # SUPPORT
 #
 
-$(eval $(call LIB,terminol/support,conv.cxx debug.cxx escape.cxx pattern.cxx time.cxx,))
+$(eval $(call LIB,terminol/support,conv.cxx debug.cxx escape.cxx lz.cxx pattern.cxx time.cxx worker_pool.cxx,))
 
 $(eval $(call EXE,TEST,terminol/support/test-support,test_support.cxx,,terminol/support,))
 
 $(eval $(call EXE,TEST,terminol/support/test-cmdline,test_cmdline.cxx,,terminol/support,))
 
+$(eval $(call EXE,TEST,terminol/support/test-lz,test_lz.cxx,,terminol/support,))
+
+$(eval $(call EXE,PRIV,terminol/support/bench-selector,bench_selector.cxx,,terminol/support,-lutil))
+
 #
 # COMMON
 #
 
-$(eval $(call LIB,terminol/common,ascii.cxx bindings.cxx bit_sets.cxx buffer.cxx config.cxx data_types.cxx deduper.cxx enums.cxx key_map.cxx parser.cxx terminal.cxx tty.cxx utf8.cxx vt_state_machine.cxx,))
+$(eval $(call LIB,terminol/common,ascii.cxx bindings.cxx bit_sets.cxx buffer.cxx config.cxx chunk_deduper.cxx control.cxx data_types.cxx deduper.cxx enums.cxx frame_scheduler.cxx history_cooler.cxx key_map.cxx parser.cxx shell_pool.cxx spill_store.cxx terminal.cxx tty.cxx tty_reader.cxx utf8.cxx vt_state_machine.cxx,))
 
 $(eval $(call EXE,TEST,terminol/common/test-utf8,test_utf8.cxx,,terminol/common terminol/support,))
 
+$(eval $(call EXE,TEST,terminol/common/test-buffer,test_buffer.cxx,,terminol/common terminol/support,))
+
+$(eval $(call EXE,TEST,terminol/common/test-frame-scheduler,test_frame_scheduler.cxx,,terminol/common terminol/support,))
+
 $(eval $(call EXE,PRIV,terminol/common/abuse,abuse.cxx,,terminol/common terminol/support,))
 
 $(eval $(call EXE,PRIV,terminol/common/sequencer,sequencer.cxx,,terminol/common terminol/support,))
@@ -232,14 +240,30 @@ $(eval $(call EXE,PRIV,terminol/common/positioner,positioner.cxx,,terminol/commo
 
 $(eval $(call EXE,PRIV,terminol/common/spinner,spinner.cxx,,terminol/common terminol/support,))
 
+$(eval $(call EXE,PRIV,terminol/common/bench-dedupe,bench_dedupe.cxx,,terminol/common terminol/support,))
+
+$(eval $(call EXE,PRIV,terminol/common/bench-tty,bench_tty.cxx,,terminol/common terminol/support,-lutil))
+
+$(eval $(call EXE,PRIV,terminol/common/bench-spawn,bench_spawn.cxx,,terminol/common terminol/support,-lutil))
+
+$(eval $(call EXE,PRIV,terminol/common/bench-shell-pool,bench_shell_pool.cxx,,terminol/common terminol/support,-lutil))
+
+$(eval $(call EXE,PRIV,terminol/common/bench-emulation,bench_emulation.cxx,$(XKB_CFLAGS),terminol/common terminol/support,$(XKB_LDFLAGS) -lutil))
+
 #
 # XCB
 #
 
-$(eval $(call LIB,terminol/xcb,basics.cxx color_set.cxx font_manager.cxx font_set.cxx window.cxx,$(XCB_CFLAGS)))
+$(eval $(call LIB,terminol/xcb,basics.cxx color_set.cxx event_batch.cxx font_manager.cxx font_set.cxx metrics_cache.cxx window.cxx,$(XCB_CFLAGS)))
+
+$(eval $(call EXE,TEST,terminol/xcb/test-event-batch,test_event_batch.cxx,$(XCB_CFLAGS),terminol/xcb terminol/support,$(XCB_LDFLAGS)))
 
 $(eval $(call EXE,DIST,terminol/xcb/terminol,terminol.cxx,$(XCB_CFLAGS),terminol/xcb terminol/common terminol/support,$(XCB_LDFLAGS) -lutil))
 
 $(eval $(call EXE,DIST,terminol/xcb/terminols,terminols.cxx,$(XCB_CFLAGS),terminol/xcb terminol/common terminol/support,$(XCB_LDFLAGS) -lutil))
 
 $(eval $(call EXE,DIST,terminol/xcb/terminolc,terminolc.cxx,$(XKB_CFLAGS),terminol/common terminol/support,$(XKB_LDFLAGS)))
+
+$(eval $(call EXE,PRIV,terminol/xcb/bench-startup,bench_startup.cxx,$(XCB_CFLAGS),terminol/support,$(XCB_LDFLAGS)))
+
+$(eval $(call EXE,PRIV,terminol/xcb/bench-windows,bench_windows.cxx,$(XKB_CFLAGS),terminol/common terminol/support,))
@@ -0,0 +1,169 @@
+// vi:noai:sw=4
+
+#include "terminol/common/deduper.hxx"
+#include "terminol/common/chunk_deduper.hxx"
+#include "terminol/common/utf8.hxx"
+#include "terminol/support/debug.hxx"
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <cstdlib>
+
+#include <time.h>
+#include <unistd.h>
+
+// Feed captured output (files, or stdin) through the line, chunk,
+// spilling and compressing dedupers and report throughput, latency of
+// scrolling back a viewport at a time, and memory.
+
+namespace {
+
+double now() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void readLines(std::istream & ist, std::vector<std::vector<Cell>> & lines) {
+    std::string str;
+
+    while (std::getline(ist, str)) {
+        std::vector<Cell> cells;
+        utf8::Machine     machine;
+
+        for (auto c : str) {
+            switch (machine.consume(c)) {
+                case utf8::Machine::State::ACCEPT:
+                    cells.push_back(Cell::utf8(machine.seq()));
+                    break;
+                case utf8::Machine::State::REJECT:
+                    machine = utf8::Machine();
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        lines.push_back(std::move(cells));
+    }
+}
+
+size_t residentBytes() {
+    std::ifstream ifs("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    ifs >> size >> resident;
+    return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+void bench(const char * name, I_Deduper & deduper,
+           const std::vector<std::vector<Cell>> & lines) {
+    const size_t VIEWPORT  = 50;
+    const size_t VIEWPORTS = 200;
+
+    std::vector<I_Deduper::Tag> tags;
+    tags.reserve(lines.size());
+
+    auto rss0 = residentBytes();
+    auto t0   = now();
+
+    for (auto & l : lines) {
+        auto cells = l;
+        tags.push_back(deduper.store(cells));
+    }
+
+    auto t1 = now();
+
+    // As the event loop would, a step per timer.
+    while (deduper.cool()) {}
+
+    auto t2   = now();
+    auto rss1 = residentBytes();
+
+    size_t cells = 0;
+    for (auto t : tags) { cells += deduper.lookup(t).size(); }
+
+    auto t3 = now();
+
+    // Scroll back to random places, a viewport at a time.
+    if (tags.size() > VIEWPORT) {
+        for (size_t v = 0; v != VIEWPORTS; ++v) {
+            auto top = static_cast<size_t>(random()) % (tags.size() - VIEWPORT);
+            for (size_t i = top; i != top + VIEWPORT; ++i) { deduper.lookup(tags[i]); }
+        }
+    }
+
+    auto t4 = now();
+
+    for (size_t i = 0; i != tags.size(); ++i) {
+        ENFORCE(deduper.lookup(tags[i]) == lines[i], "Round trip failed: " << i);
+    }
+
+    uint32_t uniqueLines, totalLines;
+    deduper.getStats(uniqueLines, totalLines);
+    size_t bytes1, bytes2;
+    deduper.getStats2(bytes1, bytes2);
+
+    std::cout
+        << std::setw(6) << name << ": "
+        << std::fixed << std::setprecision(1)
+        << "store " << std::setw(7) << lines.size() / (t1 - t0) / 1e3 << " Klines/s, "
+        << "cool " << std::setw(6) << (t2 - t1) * 1e3 << " ms, "
+        << "lookup " << std::setw(7) << cells / (t3 - t2) / 1e6 << " Mcells/s, "
+        << "viewport " << std::setw(6) << (t4 - t3) / VIEWPORTS * 1e6 << " us, "
+        << uniqueLines << "/" << totalLines << " unique, "
+        << bytes1 / 1024 << "K stored for " << bytes2 / 1024 << "K of cells "
+        << "(ratio " << std::setprecision(2)
+        << (bytes1 == 0 ? 0.0 : static_cast<double>(bytes2) / bytes1) << "), "
+        << "RSS +" << (rss1 > rss0 ? rss1 - rss0 : 0) / 1024 << "K"
+        << std::endl;
+
+    for (auto t : tags) { deduper.remove(t); }
+    deduper.getStats(uniqueLines, totalLines);
+    ENFORCE(uniqueLines == 0 && totalLines == 0, "Leaked lines.");
+    ENFORCE(deduper.getBytes() == 0, "Leaked bytes: " << deduper.getBytes());
+}
+
+} // namespace {anonymous}
+
+int main(int argc, char * argv[]) {
+    std::vector<std::vector<Cell>> lines;
+
+    if (argc == 1) {
+        readLines(std::cin, lines);
+    }
+    else {
+        for (int i = 1; i != argc; ++i) {
+            std::ifstream ifs(argv[i]);
+            if (!ifs) { FATAL("Failed to open: " << argv[i]); }
+            readLines(ifs, lines);
+        }
+    }
+
+    std::cout << lines.size() << " lines" << std::endl;
+
+    {
+        Deduper deduper;
+        bench("line", deduper, lines);
+    }
+
+    {
+        ChunkDeduper deduper;
+        bench("chunk", deduper, lines);
+    }
+
+    {
+        Deduper deduper(openSpillStore(""), false, 1024, 0);
+        bench("spill", deduper, lines);
+    }
+
+    {
+        Deduper deduper(nullptr, true, 1024, 0);
+        bench("lz", deduper, lines);
+    }
+
+    return 0;
+}
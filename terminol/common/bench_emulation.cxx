@@ -0,0 +1,187 @@
+// vi:noai:sw=4
+
+#include "terminol/common/terminal.hxx"
+#include "terminol/common/deduper.hxx"
+#include "terminol/common/locked_deduper.hxx"
+#include "terminol/support/worker_pool.hxx"
+#include "terminol/support/conv.hxx"
+#include "terminol/support/time.hxx"
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Several terminals 'cat' the same file at once, parsed on the main
+// thread and then on a worker pool. Drawing stays on the main thread and
+// only hashes what would be drawn. The final screens must agree. With
+// --fork each run carries on in a child once its pool is built, as
+// terminols --fork does when it daemonises.
+
+namespace {
+
+// The parent waits for the child and exits with its status.
+void carryOnInChild() {
+    std::cout.flush();
+
+    auto pid = ::fork();
+    ENFORCE_SYS(pid != -1, "");
+
+    if (pid != 0) {
+        int status;
+        ENFORCE_SYS(TEMP_FAILURE_RETRY(::waitpid(pid, &status, 0)) == pid, "");
+        ::_exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+    }
+}
+
+class Screen : protected Terminal::I_Observer {
+    bool     _exited;
+    uint64_t _hash;
+
+public:
+    Screen() : _exited(false), _hash(0) {}
+
+    virtual ~Screen() {}
+
+    Terminal::I_Observer & observer() { return *this; }
+
+    bool     isExited() const { return _exited; }
+    uint64_t getHash()  const { return _hash; }
+    void     clearHash()      { _hash = 14695981039346656037ULL; }
+
+protected:
+    // Terminal::I_Observer implementation:
+
+    void terminalGetDisplay(std::string & display) throw () { display = ":0"; }
+    void terminalCopy(const std::string & UNUSED(text), bool UNUSED(clipboard)) throw () {}
+    void terminalPaste(bool UNUSED(clipboard)) throw () {}
+    void terminalResizeLocalFont(int UNUSED(delta)) throw () {}
+    void terminalResizeGlobalFont(int UNUSED(delta)) throw () {}
+    void terminalResetTitleAndIcon() throw () {}
+    void terminalSetWindowTitle(const std::string & UNUSED(str)) throw () {}
+    void terminalSetIconName(const std::string & UNUSED(str)) throw () {}
+    void terminalBeep() throw () {}
+    void terminalResizeBuffer(int16_t UNUSED(rows), int16_t UNUSED(cols)) throw () {}
+    bool terminalAdmitFrame() throw () { return true; }
+    bool terminalFixDamageBegin() throw () { return true; }
+
+    void terminalDrawBg(Pos    UNUSED(pos),
+                        UColor UNUSED(color),
+                        size_t UNUSED(count)) throw () {}
+
+    void terminalDrawFg(Pos             pos,
+                        UColor          UNUSED(color),
+                        AttrSet         UNUSED(attrs),
+                        const uint8_t * str,
+                        size_t          size,
+                        size_t          UNUSED(count)) throw () {
+        for (size_t i = 0; i != size; ++i) { _hash = (_hash ^ str[i]) * 1099511628211ULL; }
+        _hash ^= pos.row * 131 + pos.col;
+    }
+
+    void terminalDrawCursor(Pos             UNUSED(pos),
+                            UColor          UNUSED(fg),
+                            UColor          UNUSED(bg),
+                            AttrSet         UNUSED(attrs),
+                            const uint8_t * UNUSED(str),
+                            size_t          UNUSED(size),
+                            bool            UNUSED(wrapNext),
+                            bool            UNUSED(focused)) throw () {}
+
+    void terminalDrawScrollbar(size_t  UNUSED(totalRows),
+                               size_t  UNUSED(historyOffset),
+                               int16_t UNUSED(visibleRows)) throw () {}
+
+    void terminalFixDamageEnd(const Region & UNUSED(damage),
+                              bool           UNUSED(scrollbar)) throw () {}
+
+    void terminalChildExited(int UNUSED(exitStatus)) throw () { _exited = true; }
+};
+
+uint64_t bench(size_t windows, size_t threads, bool fork,
+               const std::string & file, size_t fileBytes) {
+    Config        config;
+    EPollSelector selector;
+    WorkerPool    workerPool(selector, threads);
+    Deduper       deduper;
+    LockedDeduper lockedDeduper(deduper);
+
+    if (fork) { carryOnInChild(); }
+    workerPool.start();
+
+    std::vector<Screen *>   screens;
+    std::vector<Terminal *> terminals;
+
+    auto t0 = monotonicMicroseconds();
+
+    for (size_t i = 0; i != windows; ++i) {
+        screens.push_back(new Screen);
+        terminals.push_back(
+            new Terminal(screens.back()->observer(), config, selector,
+                         threads != 0 ? static_cast<I_Deduper &>(lockedDeduper) : deduper,
+                         threads != 0 ? &workerPool : nullptr, nullptr,
+                         24, 80, "0", { "cat", file }, Tty::Options()));
+    }
+
+    for (;;) {
+        bool running = false;
+        for (auto s : screens) { running = running || !s->isExited(); }
+        if (!running) { break; }
+        selector.animate();
+    }
+
+    auto t1 = monotonicMicroseconds();
+
+    std::cout
+        << std::setw(2) << threads << " threads: "
+        << std::fixed << std::setprecision(1)
+        << windows * fileBytes / 1e6 / ((t1 - t0) / 1e6) << " MB/s"
+        << std::endl;
+
+    uint64_t hash = 0;
+
+    for (size_t i = 0; i != windows; ++i) {
+        screens[i]->clearHash();
+        terminals[i]->redraw();
+        if (i == 0) { hash = screens[i]->getHash(); }
+        ENFORCE(screens[i]->getHash() == hash, "Screens differ: " << i);
+        delete terminals[i];
+        delete screens[i];
+    }
+
+    return hash;
+}
+
+} // namespace {anonymous}
+
+int main(int argc, char * argv[]) {
+    auto fork = argc > 1 && std::string(argv[1]) == "--fork";
+    auto args = argv + (fork ? 1 : 0);
+    auto argn = argc - (fork ? 1 : 0);
+
+    if (argn < 2) {
+        std::cerr << "Usage: " << argv[0] << " [--fork] FILE [WINDOWS] [THREADS]" << std::endl;
+        return 1;
+    }
+
+    std::string file    = args[1];
+    size_t      windows = argn > 2 ? unstringify<size_t>(args[2]) : 8;
+    size_t      threads = argn > 3 ? unstringify<size_t>(args[3]) :
+                                     std::thread::hardware_concurrency();
+
+    struct stat st;
+    ENFORCE_SYS(::stat(file.c_str(), &st) != -1, "Failed to stat: " << file);
+
+    std::cout << windows << " windows, " << humanSize(st.st_size) << " each" << std::endl;
+
+    auto hash = bench(windows, 0, fork, file, st.st_size);
+
+    for (size_t t = 1; t <= threads; t *= 2) {
+        ENFORCE(bench(windows, t, fork, file, st.st_size) == hash, "Differs from inline.");
+    }
+
+    return 0;
+}
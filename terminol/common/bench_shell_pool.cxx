@@ -0,0 +1,95 @@
+// vi:noai:sw=4
+
+#include "terminol/common/tty.hxx"
+#include "terminol/common/shell_pool.hxx"
+#include "terminol/support/conv.hxx"
+#include "terminol/support/time.hxx"
+
+#include <iostream>
+#include <iomanip>
+
+// Time to first prompt: from asking for a window's tty to the first
+// output of its shell, starting the shell afresh and taking it from a
+// pool that has had time to fill. Uses $SHELL, as a window would. Give
+// a slow starting shell more time to settle: bench-shell-pool 10 3000.
+
+namespace {
+
+class Prompt : protected Tty::I_Observer {
+    bool _seen;
+
+public:
+    Prompt() : _seen(false) {}
+
+    virtual ~Prompt() {}
+
+    Tty::I_Observer & observer() { return *this; }
+    bool isSeen() const { return _seen; }
+
+protected:
+    // Tty::I_Observer implementation:
+
+    void ttyData(const uint8_t * UNUSED(data), size_t UNUSED(size)) throw () { _seen = true; }
+    void ttySync() throw () {}
+    void ttyDrained() throw () {}
+    void ttyExited(int UNUSED(exitCode)) throw () {}
+};
+
+// Lets the pool refill and its shells print their prompts.
+void idle(EPollSelector & selector, uint64_t microseconds) {
+    auto t0 = monotonicMicroseconds();
+    while (monotonicMicroseconds() - t0 < microseconds) { selector.animate(); }
+}
+
+class Ticker : protected I_Selector::I_TimerHandler {
+    I_Selector & _selector;
+    int          _timer;
+
+public:
+    explicit Ticker(I_Selector & selector) :
+        _selector(selector), _timer(_selector.addTimer(this, 10, true)) {}
+
+    virtual ~Ticker() { _selector.removeTimer(_timer); }
+
+protected:
+    // I_Selector::I_TimerHandler implementation:
+
+    void handleTimer(int UNUSED(timer)) throw () {}
+};
+
+double promptMicroseconds(const Config & config, size_t iterations, uint64_t settleMs) {
+    EPollSelector selector;
+    Ticker        ticker(selector);     // so idle() gets woken
+    ShellPool     pool(selector, config);
+    uint64_t      total = 0;
+
+    for (size_t i = 0; i != iterations; ++i) {
+        idle(selector, settleMs * 1000);
+
+        Prompt prompt;
+        auto   t0 = monotonicMicroseconds();
+        Tty    tty(prompt.observer(), selector, config, 24, 80, "0", Tty::Command(), Tty::Options(), &pool);
+        while (!prompt.isSeen()) { selector.animate(); }
+        total += monotonicMicroseconds() - t0;
+    }
+
+    return static_cast<double>(total) / iterations;
+}
+
+} // namespace {anonymous}
+
+int main(int argc, char * argv[]) {
+    size_t   iterations = argc > 1 ? unstringify<size_t>(argv[1]) : 10;
+    uint64_t settleMs   = argc > 2 ? unstringify<uint64_t>(argv[2]) : 500;
+
+    Config cold;
+    Config pooled;
+    pooled.shellPool = 1;
+
+    std::cout
+        << std::fixed << std::setprecision(0)
+        << "cold   " << std::setw(7) << promptMicroseconds(cold, iterations, settleMs) << " us" << std::endl
+        << "pooled " << std::setw(7) << promptMicroseconds(pooled, iterations, settleMs) << " us" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+// vi:noai:sw=4
+
+#include "terminol/common/tty.hxx"
+#include "terminol/support/conv.hxx"
+#include "terminol/support/time.hxx"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+// How long it takes to start a window's shell as the process grows, as
+// the terminols daemon does with scroll-back. A bare fork() is shown for
+// comparison, since that's what Tty used to pay before the exec.
+
+namespace {
+
+const int ITERATIONS = 20;
+
+class Sink : protected Tty::I_Observer {
+public:
+    Sink() {}
+
+    virtual ~Sink() {}
+
+    Tty::I_Observer & observer() { return *this; }
+
+protected:
+    // Tty::I_Observer implementation:
+
+    void ttyData(const uint8_t * UNUSED(data), size_t UNUSED(size)) throw () {}
+    void ttySync() throw () {}
+    void ttyDrained() throw () {}
+    void ttyExited(int UNUSED(exitCode)) throw () {}
+};
+
+double forkMicroseconds() {
+    uint64_t total = 0;
+
+    for (int i = 0; i != ITERATIONS; ++i) {
+        auto t0  = monotonicMicroseconds();
+        auto pid = ::fork();
+        ENFORCE_SYS(pid != -1, "");
+        if (pid == 0) { ::_exit(0); }
+        total += monotonicMicroseconds() - t0;
+        ENFORCE_SYS(::waitpid(pid, nullptr, 0) == pid, "");
+    }
+
+    return static_cast<double>(total) / ITERATIONS;
+}
+
+double ttyMicroseconds() {
+    Config        config;
+    EPollSelector selector;
+    Sink          sink;
+    uint64_t      total = 0;
+
+    for (int i = 0; i != ITERATIONS; ++i) {
+        auto t0 = monotonicMicroseconds();
+        Tty tty(sink.observer(), selector, config, 24, 80, "0", { "true" });
+        total += monotonicMicroseconds() - t0;
+    }
+
+    return static_cast<double>(total) / ITERATIONS;
+}
+
+} // namespace {anonymous}
+
+int main(int argc, char * argv[]) {
+    std::vector<size_t> sizes;
+
+    for (int i = 1; i < argc; ++i) { sizes.push_back(unhumanSize(argv[i])); }
+    if (sizes.empty()) { sizes = { 0, 256 << 20, 1 << 30, 2UL << 30 }; }
+
+    for (auto size : sizes) {
+        // Touched, so the pages are really there.
+        std::vector<char> ballast(size, 1);
+
+        std::cout
+            << std::setw(6) << humanSize(size) << " resident: "
+            << std::fixed << std::setprecision(0)
+            << "fork " << std::setw(7) << forkMicroseconds() << " us, "
+            << "Tty " << std::setw(7) << ttyMicroseconds() << " us"
+            << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+// vi:noai:sw=4
+
+#include "terminol/common/tty.hxx"
+#include "terminol/common/utf8.hxx"
+#include "terminol/support/conv.hxx"
+#include "terminol/support/time.hxx"
+
+#include <iostream>
+#include <iomanip>
+
+#include <sys/stat.h>
+
+// 'cat' a file through a Tty, with and without the reader thread. The
+// observer decodes the bytes and spins for a while on each sync to stand
+// in for drawing, which is when a single thread leaves the child blocked
+// on a full pty.
+
+namespace {
+
+class Sink : protected Tty::I_Observer {
+    uint64_t       _drawUs;
+    size_t         _bytes;
+    size_t         _syncs;
+    bool           _exited;
+    utf8::Machine  _machine;
+
+public:
+    explicit Sink(uint64_t drawUs) :
+        _drawUs(drawUs), _bytes(0), _syncs(0), _exited(false), _machine() {}
+
+    virtual ~Sink() {}
+
+    Tty::I_Observer & observer() { return *this; }
+
+    size_t getBytes() const { return _bytes; }
+    size_t getSyncs() const { return _syncs; }
+    bool   isExited() const { return _exited; }
+
+protected:
+    // Tty::I_Observer implementation:
+
+    void ttyData(const uint8_t * data, size_t size) throw () {
+        for (size_t i = 0; i != size; ++i) {
+            if (_machine.consume(data[i]) == utf8::Machine::State::REJECT) {
+                _machine = utf8::Machine();
+            }
+        }
+        _bytes += size;
+    }
+
+    void ttySync() throw () {
+        auto until = monotonicMicroseconds() + _drawUs;
+        while (monotonicMicroseconds() < until) {}
+        ++_syncs;
+    }
+
+    void ttyDrained() throw () {}
+
+    void ttyExited(int UNUSED(exitCode)) throw () {
+        _exited = true;
+    }
+};
+
+void bench(const char * name, bool thread, const std::string & file,
+           size_t fileBytes, uint64_t drawUs) {
+    Config config;
+    config.ttyReaderThread = thread;
+
+    EPollSelector selector;
+    Sink          sink(drawUs);
+    Tty::Command  command = { "cat", file };
+    auto          t0      = monotonicMicroseconds();
+
+    {
+        Tty tty(sink.observer(), selector, config, 24, 80, "0", command);
+        while (!sink.isExited()) { selector.animate(); }
+    }
+
+    auto t1 = monotonicMicroseconds();
+
+    std::cout
+        << std::setw(7) << name << ": "
+        << std::fixed << std::setprecision(1)
+        << sink.getBytes() / 1e6 / ((t1 - t0) / 1e6) << " MB/s, "
+        << sink.getSyncs() << " syncs"
+        << std::endl;
+
+    // The pty turns newlines into CR-LF, so at least this much.
+    ENFORCE(sink.getBytes() >= fileBytes, "Short: " << sink.getBytes());
+}
+
+} // namespace {anonymous}
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " FILE [DRAW-US]" << std::endl;
+        return 1;
+    }
+
+    std::string file   = argv[1];
+    uint64_t    drawUs = argc > 2 ? unstringify<uint64_t>(argv[2]) : 2000;
+
+    struct stat st;
+    ENFORCE_SYS(::stat(file.c_str(), &st) != -1, "Failed to stat: " << file);
+
+    std::cout << humanSize(st.st_size) << ", " << drawUs << "us per draw" << std::endl;
+
+    bench("inline", false, file, st.st_size, drawUs);
+    bench("thread", true,  file, st.st_size, drawUs);
+
+    return 0;
+}
@@ -47,6 +47,9 @@ enum class TabDir { FORWARD, BACKWARD };
 //
 
 class Buffer {
+    static const size_t STAGE_LIMIT = 64;       // completed lines held before storing
+
+protected:
     struct APos {
         int32_t row; // >= 0 --> _active, < 0 --> _history
         int16_t col;
@@ -88,6 +91,7 @@ class Buffer {
             (lhs.apos.row == rhs.apos.row && lhs.apos.col == rhs.apos.col && lhs.hand < rhs.hand);
     }
 
+private:
     // Historical-Line
     struct HLine {
         uint32_t index;
@@ -161,12 +165,14 @@ class Buffer {
     I_Deduper                  & _deduper;
     std::deque<I_Deduper::Tag>   _tags;
     std::vector<Cell>            _pending;
+    std::deque<std::vector<Cell>> _staged;          // completed lines awaiting store()
     std::deque<HLine>            _history;
     std::deque<ALine>            _active;
     std::vector<Damage>          _damage;           // *viewport* relative damage
     std::vector<bool>            _tabs;
     uint32_t                     _scrollOffset;     // 0 -> scroll bottom
     uint32_t                     _historyLimit;
+    size_t                       _historyCells;     // in stored and staged lines
     uint32_t                     _lostTags;
     int16_t                      _cols;
     int16_t                      _marginBegin;
@@ -206,6 +212,7 @@ public:
         _tabs(cols),
         _scrollOffset(0),
         _historyLimit(historyLimit),
+        _historyCells(0),
         _lostTags(0),
         _cols(cols),
         _barDamage(true),
@@ -235,13 +242,22 @@ public:
     uint32_t getScrollOffset() const { return _scrollOffset; }
     bool     getBarDamage() const { return _barDamage; }
 
+    // What the history costs before deduplication, including the pending line.
+    size_t getHistoryBytes() const {
+        return (_historyCells + _pending.size()) * sizeof(Cell) +
+            _tags.size() * sizeof(I_Deduper::Tag) + _history.size() * sizeof(HLine);
+    }
+
     void markSelection(HPos hpos) {
-        damageSelection();
+        auto oldMark  = _selectMark;
+        auto oldDelim = _selectDelim;
         _selectMark = _selectDelim = HAPos(hpos, _scrollOffset);
+        damageSelection(oldMark, oldDelim);
     }
 
     void delimitSelection(HPos hpos, bool fresh) {
-        damageSelection();
+        auto oldMark  = _selectMark;
+        auto oldDelim = _selectDelim;
 
         HAPos hapos(hpos, _scrollOffset);
 
@@ -269,15 +285,57 @@ public:
         }
 
         _selectDelim = hapos;
-        damageSelection();
+        damageSelection(oldMark, oldDelim);
     }
 
     void expandSelection(HPos UNUSED(pos), int UNUSED(level)) {
     }
 
     void clearSelection() {
-        damageSelection();
+        auto oldDelim = _selectDelim;
         _selectDelim = _selectMark;     // XXX need to be careful about this not pointing to valid data
+        damageSelection(_selectMark, oldDelim);
+    }
+
+    // Store the staged lines with the deduper. Called at the end of each
+    // batch of tty input, and by bump() when the staging ring is full.
+    void commitLines() {
+        if (!_staged.empty()) {
+            auto index = _tags.size() - 1 - _staged.size();
+
+            for (auto & cells : _staged) {
+                ASSERT(_tags[index] == I_Deduper::invalidTag(), "");
+                auto tag = _deduper.store(cells);
+                ASSERT(tag != I_Deduper::invalidTag(), "");
+                _tags[index++] = tag;
+            }
+
+            ASSERT(index == _tags.size() - 1, "");
+            _staged.clear();
+        }
+    }
+
+    // Drop the oldest history lines, freeing about bytes of history.
+    // Returns false if there was nothing to drop.
+    bool trimHistory(size_t bytes) {
+        if (_tags.size() <= 1) {
+            return false;
+        }
+
+        auto target = getHistoryBytes() > bytes ? getHistoryBytes() - bytes : 0;
+
+        do {
+            dropOldestLine();
+        } while (_tags.size() > 1 && getHistoryBytes() > target);
+
+        if (_scrollOffset == 0) {
+            _barDamage = true;
+        }
+        else {
+            damageViewport(true);
+        }
+
+        return true;
     }
 
     bool getSelectedText(std::string & text) const {
@@ -291,14 +349,8 @@ public:
 
                 if (i.row < 0) {
                     auto & hline = _history[_history.size() + i.row];
-                    auto   tag   = _tags[hline.index - _lostTags];
 
-                    if (tag == I_Deduper::invalidTag()) {
-                        cellsPtr = &_pending;
-                    }
-                    else {
-                        cellsPtr = &_deduper.lookup(tag);
-                    }
+                    cellsPtr = &getCells(hline.index - _lostTags);
 
                     offset = hline.seqnum * getCols();
                     wrap   = cellsPtr->size() - offset;
@@ -343,6 +395,8 @@ public:
             _tags.clear();
             _history.clear();
             _pending.clear();
+            _staged.clear();
+            _historyCells = 0;
 
             if (_scrollOffset == 0) {
                 _barDamage = true;
@@ -627,6 +681,8 @@ public:
                 bump();
             }
 
+            commitLines();
+
             //dumpHistory(std::cerr);
 
             // This block is copied from bump().
@@ -970,80 +1026,32 @@ public:
         APos selBegin, selEnd;
         bool selValid = normaliseSelection(selBegin, selEnd);
 
+        // How a selected cell gets its colour, settled once for all cells.
+        auto selStock = _config.customSelectBgColor;
+        auto selFlip  = XOR(reverse, !selStock && !_config.customSelectFgColor);
+
         for (int16_t r = 0; r != static_cast<int16_t>(_active.size()); ++r) {
             auto & d = _damage[r];
             if (d.begin == d.end) { continue; }
 
-            const std::vector<Cell> * cellsPtr;
-            uint32_t                  offset;
-            int16_t                   wrap;
-
-            if (static_cast<uint32_t>(r) < _scrollOffset) {
-                auto & hline = _history[_history.size() - _scrollOffset + r];
-                auto   tag   = _tags[hline.index - _lostTags];
-
-                if (tag == I_Deduper::invalidTag()) {
-                    cellsPtr = &_pending;
-                }
-                else {
-                    cellsPtr = &_deduper.lookup(tag);
-                }
-
-                offset = hline.seqnum * getCols();
-                wrap   = cellsPtr->size() - offset;
-            }
-            else {
-                auto & aline = _active[r - _scrollOffset];
+            uint32_t offset;
+            int16_t  wrap;
+            auto &   cells = getRowCells(r, offset, wrap);
 
-                cellsPtr = &aline.cells;
-                offset   = 0;
-                wrap     = aline.wrap;
-            }
-
-            auto & cells = *cellsPtr;
-            auto   blank = Cell::blank();
+            int16_t s0, s1;
+            selectedRange(r, selValid, selBegin, selEnd, wrap, d, s0, s1);
 
             auto bg0 = UColor::stock(UColor::Name::TEXT_BG);
             auto c0  = d.begin;  // Accumulation start column.
-            auto c1  = c0;
-
-            for (; c1 != d.end; ++c1) {
-                auto   apos     = APos(r - _scrollOffset, c1);
-                auto   selected = selValid && isCellSelected(apos, selBegin, selEnd, wrap);
-                auto   c        = c1 + offset;
-                auto & cell     = c < cells.size() ? cells[c] : blank;
-                auto & attrs    = cell.style.attrs;
-                auto   swap     = XOR(reverse, attrs.get(Attr::INVERSE));
-                auto   bg1      = bg0; // About to be overridden.
-
-                if (selected) {
-                    if (_config.customSelectBgColor) {
-                        bg1 = UColor::stock(UColor::Name::SELECT_BG);
-                    }
-                    else if (_config.customSelectFgColor) {
-                        bg1 = swap ? cell.style.fg : cell.style.bg;
-                    }
-                    else {
-                        bg1 = !swap ? cell.style.fg : cell.style.bg;
-                    }
-                }
-                else {
-                    bg1 = swap ? cell.style.fg : cell.style.bg;
-                }
 
-                if (bg0 != bg1) {
-                    if (c1 != c0) {
-                        func(Pos(r, c0), bg0, c1 - c0);
-                    }
-
-                    c0  = c1;
-                    bg0 = bg1;
-                }
-            }
+            // Unselected, selected and unselected again; runs carry over.
+            scanBg(r, cells, offset, false,    reverse, d.begin, s0,    c0, bg0, func);
+            scanBg(r, cells, offset, selStock, selFlip, s0,      s1,    c0, bg0, func);
+            scanBg(r, cells, offset, false,    reverse, s1,      d.end, c0, bg0, func);
 
             // There may be an unterminated run to flush.
-            if (c1 != c0) {
-                func(Pos(r, c0), bg0, c1 - c0);
+            if (d.end != c0) {
+                func(Pos(r, c0), bg0, d.end - c0);
             }
         }
     }
@@ -1053,94 +1061,38 @@ public:
         APos selBegin, selEnd;
         bool selValid = normaliseSelection(selBegin, selEnd);
 
+        // How a selected cell gets its colour, settled once for all cells.
+        auto selStock = _config.customSelectFgColor;
+        auto selFlip  = XOR(reverse, !selStock && !_config.customSelectBgColor);
+
         std::vector<uint8_t> run;         // Buffer for accumulating character runs.
 
         for (int16_t r = 0; r != static_cast<int16_t>(_active.size()); ++r) {
             auto & d = _damage[r];
             if (d.begin == d.end) { continue; }
 
-            const std::vector<Cell> * cellsPtr;
-            uint32_t                  offset;
-            int16_t                   wrap;
-
-            if (static_cast<uint32_t>(r) < _scrollOffset) {
-                auto & hline = _history[_history.size() - _scrollOffset + r];
-                auto   tag   = _tags[hline.index - _lostTags];
-
-                if (tag == I_Deduper::invalidTag()) {
-                    cellsPtr = &_pending;
-                }
-                else {
-                    cellsPtr = &_deduper.lookup(tag);
-                }
-
-                offset = hline.seqnum * getCols();
-                wrap   = cellsPtr->size() - offset;
-            }
-            else {
-                auto & aline = _active[r - _scrollOffset];
-
-                cellsPtr = &aline.cells;
-                offset   = 0;
-                wrap     = aline.wrap;
-            }
+            uint32_t offset;
+            int16_t  wrap;
+            auto &   cells = getRowCells(r, offset, wrap);
 
-            auto & cells = *cellsPtr;
-            auto   blank = Cell::blank();
+            int16_t s0, s1;
+            selectedRange(r, selValid, selBegin, selEnd, wrap, d, s0, s1);
 
             auto fg0    = UColor::stock(UColor::Name::TEXT_FG);
             auto attrs0 = AttrSet();
             auto c0     = d.begin;   // Accumulation start column.
-            auto c1     = c0;
-
-            for (; c1 != d.end; ++c1) {
-                auto   apos     = APos(r - _scrollOffset, c1);
-                auto   selected = selValid && isCellSelected(apos, selBegin, selEnd, wrap);
-                auto   c        = c1 + offset;
-                auto & cell     = c < cells.size() ? cells[c] : blank;
-                auto & attrs1   = cell.style.attrs;
-                auto   swap     = XOR(reverse, attrs1.get(Attr::INVERSE));
-                auto   fg1      = fg0; // About to be overridden.
-
-                if (selected) {
-                    if (_config.customSelectFgColor) {
-                        fg1 = UColor::stock(UColor::Name::SELECT_FG);
-                    }
-                    else if (_config.customSelectBgColor) {
-                        fg1 = swap ? cell.style.bg : cell.style.fg;
-                    }
-                    else {
-                        fg1 = !swap ? cell.style.bg : cell.style.fg;
-                    }
-                }
-                else {
-                    fg1 = swap ? cell.style.bg : cell.style.fg;
-                }
-
-                if (fg0 != fg1 || attrs0 != attrs1) {
-                    if (c1 != c0) {
-                        // flush run
-                        auto size = run.size();
-                        run.push_back(NUL);
-                        func(Pos(r, c0), fg0, attrs0, &run.front(), size, c1 - c0);
-                        run.clear();
-                    }
-
-                    c0     = c1;
-                    fg0    = fg1;
-                    attrs0 = attrs1;
-                }
 
-                utf8::Length length = utf8::leadLength(cell.seq.lead());
-                std::copy(cell.seq.bytes, cell.seq.bytes + length, std::back_inserter(run));
-            }
+            // Unselected, selected and unselected again; runs carry over.
+            scanFg(r, cells, offset, false,    reverse, d.begin, s0,    c0, fg0, attrs0, run, func);
+            scanFg(r, cells, offset, selStock, selFlip, s0,      s1,    c0, fg0, attrs0, run, func);
+            scanFg(r, cells, offset, false,    reverse, s1,      d.end, c0, fg0, attrs0, run, func);
 
             // There may be an unterminated run to flush.
-            if (c1 != c0) {
+            if (d.end != c0) {
                 // flush run
                 auto size = run.size();
                 run.push_back(NUL);
-                func(Pos(r, c0), fg0, attrs0, &run.front(), size, c1 - c0);
+                func(Pos(r, c0), fg0, attrs0, &run.front(), size, d.end - c0);
                 run.clear();
             }
         }
@@ -1211,7 +1163,7 @@ public:
                 << std::hex << std::uppercase << t << ": "
                 << std::setfill(' ') << std::dec << " \'";
 
-            auto & cells = t != I_Deduper::invalidTag() ? _deduper.lookup(t) : _pending;
+            auto & cells = getCells(i);
 
             for (auto & c : cells) {
                 ost << c.seq;
@@ -1236,8 +1188,7 @@ public:
                 << std::setw(2) << l.seqnum << " "
                 << std::setw(3) << l.size << " \'";
 
-            auto tag = _tags[l.index - _lostTags];
-            auto & cells = tag != I_Deduper::invalidTag() ? _deduper.lookup(tag) : _pending;
+            auto & cells = getCells(l.index - _lostTags);
 
             size_t offset = l.seqnum * getCols();
             const Cell blank = Cell::blank();
@@ -1313,9 +1264,155 @@ protected:
         }
     }
 
+    // The cells of a row of the viewport, from offset, and where it wraps.
+    const std::vector<Cell> & getRowCells(int16_t r, uint32_t & offset, int16_t & wrap) const {
+        if (static_cast<uint32_t>(r) < _scrollOffset) {
+            auto & hline = _history[_history.size() - _scrollOffset + r];
+            auto & cells = getCells(hline.index - _lostTags);
+
+            offset = hline.seqnum * getCols();
+            wrap   = cells.size() - offset;
+            return cells;
+        }
+        else {
+            auto & aline = _active[r - _scrollOffset];
+
+            offset = 0;
+            wrap   = aline.wrap;
+            return aline.cells;
+        }
+    }
+
+    // The selected columns of a row, within its damage: [begin, s0) and
+    // [s1, end) are unselected, [s0, s1) selected.
+    void selectedRange(int16_t r, bool selValid, APos selBegin, APos selEnd, int16_t wrap,
+                       const Damage & d, int16_t & s0, int16_t & s1) const {
+        s0 = s1 = d.end;
+
+        if (selValid) {
+            int16_t b, e;
+            selectedSpan(r - static_cast<int32_t>(_scrollOffset), selBegin, selEnd, wrap, b, e);
+
+            if (b != e && b < d.end && e > d.begin) {
+                s0 = std::max(b, d.begin);
+                s1 = std::min(e, d.end);
+            }
+        }
+    }
+
+    // Extend or break the background run of row r over columns
+    // [begin, end). A cell's colour is the stock selection colour if
+    // stock, otherwise its fg if flip differs from its INVERSE attribute,
+    // otherwise its bg.
+    template <class Func>
+    void scanBg(int16_t r, const std::vector<Cell> & cells, uint32_t offset,
+                bool stock, bool flip, int16_t begin, int16_t end,
+                int16_t & c0, UColor & bg0, Func & func) const {
+        if (begin == end) { return; }
+
+        if (stock) {
+            auto bg1 = UColor::stock(UColor::Name::SELECT_BG);
+            if (bg0 != bg1) {
+                if (begin != c0) { func(Pos(r, c0), bg0, begin - c0); }
+                c0  = begin;
+                bg0 = bg1;
+            }
+            return;
+        }
+
+        // Past the stored cells, the line is blank.
+        int16_t stored = std::min<int32_t>(end, std::max<int32_t>(
+                begin, static_cast<int32_t>(cells.size()) - static_cast<int32_t>(offset)));
+
+        for (auto c1 = begin; c1 != stored; ++c1) {
+            auto & style = cells[c1 + offset].style;
+            auto & bg1   = XOR(flip, style.attrs.get(Attr::INVERSE)) ? style.fg : style.bg;
+
+            if (bg0 != bg1) {
+                if (c1 != c0) { func(Pos(r, c0), bg0, c1 - c0); }
+                c0  = c1;
+                bg0 = bg1;
+            }
+        }
+
+        if (stored != end) {
+            auto   blank = Cell::blank();
+            auto & bg1   = XOR(flip, blank.style.attrs.get(Attr::INVERSE)) ?
+                blank.style.fg : blank.style.bg;
+
+            if (bg0 != bg1) {
+                if (stored != c0) { func(Pos(r, c0), bg0, stored - c0); }
+                c0  = stored;
+                bg0 = bg1;
+            }
+        }
+    }
+
+    // As scanBg(), for the foreground: runs also break where the
+    // attributes change, and accumulate the text in run.
+    template <class Func>
+    void scanFg(int16_t r, const std::vector<Cell> & cells, uint32_t offset,
+                bool stock, bool flip, int16_t begin, int16_t end,
+                int16_t & c0, UColor & fg0, AttrSet & attrs0,
+                std::vector<uint8_t> & run, Func & func) const {
+        const auto stockFg = UColor::stock(UColor::Name::SELECT_FG);
+        const auto blank   = Cell::blank();
+
+        for (auto c1 = begin; c1 != end; ++c1) {
+            auto   c      = c1 + offset;
+            auto & cell   = c < cells.size() ? cells[c] : blank;
+            auto & style  = cell.style;
+            auto & attrs1 = style.attrs;
+            auto & fg1    = stock ? stockFg :
+                XOR(flip, attrs1.get(Attr::INVERSE)) ? style.bg : style.fg;
+
+            if (fg0 != fg1 || attrs0 != attrs1) {
+                if (c1 != c0) {
+                    // flush run
+                    auto size = run.size();
+                    run.push_back(NUL);
+                    func(Pos(r, c0), fg0, attrs0, &run.front(), size, c1 - c0);
+                    run.clear();
+                }
+
+                c0     = c1;
+                fg0    = fg1;
+                attrs0 = attrs1;
+            }
+
+            utf8::Length length = utf8::leadLength(cell.seq.lead());
+            run.insert(run.end(), cell.seq.bytes, cell.seq.bytes + length);
+        }
+    }
+
+    // The columns [colBegin, colEnd) of a row that a normalised selection
+    // covers, the same cells as isCellSelected(). Wrap only matters on the
+    // first and last rows of the selection.
+    void selectedSpan(int32_t row, APos begin, APos end, int16_t wrap,
+                      int16_t & colBegin, int16_t & colEnd) const {
+        colBegin = colEnd = 0;
+
+        if (row < begin.row || row > end.row) { return; }
+
+        if (row == begin.row) {
+            if (begin.col >= wrap) { return; }
+            colBegin = begin.col;
+        }
+
+        colEnd = getCols();
+
+        if (row == end.row && end.col <= wrap) {
+            colEnd = std::max(colBegin, end.col);
+        }
+    }
+
     bool normaliseSelection(APos & begin, APos & end) const {
-        auto b = _selectMark;
-        auto e = _selectDelim;
+        return normaliseSelection(_selectMark, _selectDelim, begin, end);
+    }
+
+    bool normaliseSelection(HAPos mark, HAPos delim, APos & begin, APos & end) const {
+        auto b = mark;
+        auto e = delim;
 
         if (b == e) {
             return false;
@@ -1409,8 +1506,73 @@ protected:
         }
     }
 
-    void damageSelection() {
-        damageViewport(false);        // FIXME just damage selection
+    // Cells of the logical line at index (relative to _lostTags). Lines
+    // that aren't stored yet are the pending line (always last) and the
+    // staged lines immediately before it.
+    const std::vector<Cell> & getCells(size_t index) const {
+        ASSERT(index < _tags.size(), "");
+        auto tag = _tags[index];
+
+        if (tag != I_Deduper::invalidTag()) {
+            return _deduper.lookup(tag);
+        }
+        else if (index == _tags.size() - 1) {
+            return _pending;
+        }
+        else {
+            auto first = _tags.size() - 1 - _staged.size();
+            ASSERT(index >= first, "");
+            return _staged[index - first];
+        }
+    }
+
+    // Where a row of the viewport wraps.
+    int16_t getWrap(int16_t r) const {
+        uint32_t offset;
+        int16_t  wrap;
+        getRowCells(r, offset, wrap);
+        return wrap;
+    }
+
+    // Damage only the cells whose selectedness has changed, with the
+    // selection having been from oldMark to oldDelim.
+    void damageSelection(HAPos oldMark, HAPos oldDelim) {
+        APos oldBegin, oldEnd, newBegin, newEnd;
+        auto oldValid = normaliseSelection(oldMark, oldDelim, oldBegin, oldEnd);
+        auto newValid = normaliseSelection(_selectMark, _selectDelim, newBegin, newEnd);
+
+        if (!oldValid && !newValid) { return; }
+
+        for (int16_t r = 0; r != static_cast<int16_t>(_damage.size()); ++r) {
+            auto row = static_cast<int32_t>(r) - static_cast<int32_t>(_scrollOffset);
+
+            auto inOld = oldValid && row >= oldBegin.row && row <= oldEnd.row;
+            auto inNew = newValid && row >= newBegin.row && row <= newEnd.row;
+            if (!inOld && !inNew) { continue; }
+
+            // Looking up a history line isn't free, so only where it counts.
+            auto edge = (inOld && (row == oldBegin.row || row == oldEnd.row)) ||
+                        (inNew && (row == newBegin.row || row == newEnd.row));
+            auto wrap = edge ? getWrap(r) : getCols();
+
+            int16_t b0 = 0, e0 = 0, b1 = 0, e1 = 0;
+            if (inOld) { selectedSpan(row, oldBegin, oldEnd, wrap, b0, e0); }
+            if (inNew) { selectedSpan(row, newBegin, newEnd, wrap, b1, e1); }
+
+            auto & d = _damage[r];
+
+            if (b0 == e0) {
+                if (b1 != e1) { d.damageAdd(b1, e1); }
+            }
+            else if (b1 == e1) {
+                d.damageAdd(b0, e0);
+            }
+            else {
+                // The symmetric difference: at either or both ends.
+                if (b0 != b1) { d.damageAdd(std::min(b0, b1), std::max(b0, b1)); }
+                if (e0 != e1) { d.damageAdd(std::min(e0, e1), std::max(e0, e1)); }
+            }
+        }
     }
 
     void addLine() {
@@ -1467,17 +1629,18 @@ protected:
                 size_t finalSize = hline.seqnum * getCols() + hline.size;
                 ASSERT(finalSize <= _pending.size(), "");
                 _pending.erase(_pending.begin() + finalSize, _pending.end());
-                auto tag = _deduper.store(_pending);
-                ASSERT(tag != I_Deduper::invalidTag(), "");
-                _tags.back() = tag;
+                // Stage the completed line, its tag stays invalid until commitLines().
+                _historyCells += _pending.size();
+                _staged.push_back(std::move(_pending));
             }
 
-            ASSERT(_tags.empty() || _tags.back() != I_Deduper::invalidTag(), "");
             ASSERT(_history.empty() || _history.back().index - _lostTags == _tags.size() - 1, "");
 
             _pending = std::move(aline.cells);
             _tags.push_back(I_Deduper::invalidTag());
             _history.push_back(HLine(_tags.size() + _lostTags - 1, 0, aline.wrap));
+
+            if (_staged.size() == STAGE_LIMIT) { commitLines(); }
         }
 
         ASSERT(!_tags.empty() && _tags.back() == I_Deduper::invalidTag(), "");
@@ -1499,6 +1662,7 @@ protected:
             auto tag = _tags.back();
             _deduper.lookupRemove(tag, _pending);
             _tags.back() = I_Deduper::invalidTag();
+            _historyCells -= _pending.size();
         }
 
         size_t offset = hline.seqnum * _cols;
@@ -1513,20 +1677,54 @@ protected:
         if (_history.empty() || _history.back().index - _lostTags != _tags.size() - 1) {
             _tags.pop_back();
             _pending.clear();
+
+            if (!_staged.empty()) {
+                // The last staged line becomes the pending line.
+                _pending = std::move(_staged.back());
+                _staged.pop_back();
+                _historyCells -= _pending.size();
+            }
         }
     }
 
     void enforceHistoryLimit() {
         while (_tags.size() > _historyLimit) {
-            while (!_history.empty() && _history.front().index == _lostTags) {
-                if (_scrollOffset == _history.size()) { --_scrollOffset; }
-                _history.pop_front();
+            dropOldestLine();
+        }
+
+        auto byteLimit = _config.scrollBackBytes;
+
+        if (byteLimit != 0) {
+            // Never drop the pending line.
+            while (_tags.size() > 1 && getHistoryBytes() > byteLimit) {
+                dropOldestLine();
             }
+        }
+    }
+
+    void dropOldestLine() {
+        ASSERT(!_tags.empty(), "");
+
+        while (!_history.empty() && _history.front().index == _lostTags) {
+            if (_scrollOffset == _history.size()) { --_scrollOffset; }
+            _history.pop_front();
+        }
 
+        if (_tags.front() != I_Deduper::invalidTag()) {
+            _historyCells -= _deduper.getLength(_tags.front());
             _deduper.remove(_tags.front());
-            _tags.pop_front();
-            ++_lostTags;
         }
+        else if (_tags.size() != 1) {
+            ASSERT(!_staged.empty(), "");
+            _historyCells -= _staged.front().size();
+            _staged.pop_front();
+        }
+        else {
+            _pending.clear();
+        }
+
+        _tags.pop_front();
+        ++_lostTags;
     }
 };
 
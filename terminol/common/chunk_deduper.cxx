@@ -0,0 +1,3 @@
+// vi:noai:sw=4
+
+#include "terminol/common/chunk_deduper.hxx"
@@ -0,0 +1,298 @@
+// vi:noai:sw=4
+
+#ifndef COMMON__CHUNK_DEDUPER__HXX
+#define COMMON__CHUNK_DEDUPER__HXX
+
+#include "terminol/common/deduper.hxx"
+
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+//
+// A deduper that splits each line into content-defined chunks and
+// deduplicates the chunks rather than the whole line. A line is stored
+// as a short list of chunk tags. This pays off for logs where every line
+// differs only by a timestamp or counter prefix: the boundaries re-align
+// shortly after the varying prefix so the remainder of the line is shared.
+//
+// Note, lookup() re-assembles the line into a scratch buffer, so the
+// returned reference is only valid until the next call into the deduper.
+//
+
+class ChunkDeduper : public I_Deduper {
+    typedef uint32_t ChunkTag;
+
+    static const size_t   MIN_CHUNK = 8;        // cells
+    static const size_t   MAX_CHUNK = 64;       // cells
+    static const uint32_t BOUNDARY  = 0x0F00;   // ~1:16 past MIN_CHUNK, ~12 cell window
+
+    struct Chunk {
+        std::vector<Cell> cells;
+        uint32_t          refs;
+
+        Chunk(std::vector<Cell>::const_iterator begin,
+              std::vector<Cell>::const_iterator end) : cells(begin, end), refs(0) {}
+    };
+
+    struct Line {
+        std::vector<ChunkTag> chunks;
+        uint32_t              size;     // cells
+        uint32_t              refs;
+
+        Line(std::vector<ChunkTag> & chunks_, uint32_t size_) :
+            chunks(std::move(chunks_)), size(size_), refs(1) {}
+    };
+
+    std::unordered_map<ChunkTag, Chunk> _chunks;
+    std::unordered_map<Tag, Line>       _lines;
+    size_t                              _totalRefs;
+    size_t                              _bytes;
+
+    mutable std::vector<Cell>           _scratch;
+    mutable Tag                         _scratchTag;
+
+public:
+    ChunkDeduper() :
+        _chunks(), _lines(), _totalRefs(0), _bytes(0), _scratch(), _scratchTag(invalidTag()) {}
+    virtual ~ChunkDeduper() {}
+
+    Tag store(std::vector<Cell> & cells) {
+        std::vector<ChunkTag> chunks;
+
+        size_t begin = 0;
+        while (begin != cells.size()) {
+            auto end = nextBoundary(cells, begin);
+            chunks.push_back(findChunk(cells.begin() + begin, cells.begin() + end));
+            begin = end;
+        }
+
+        auto tag = makeTag(chunks);
+
+again:
+        auto iter = _lines.find(tag);
+
+        if (iter == _lines.end()) {
+            for (auto c : chunks) { ++_chunks.find(c)->second.refs; }
+            _bytes += chunks.size() * sizeof(ChunkTag);
+            _lines.insert(std::make_pair(tag, Line(chunks, cells.size())));
+        }
+        else {
+            auto & line = iter->second;
+
+            if (chunks != line.chunks) {
+                ENFORCE(static_cast<Tag>(_lines.size()) != invalidTag(), "No dedupe room left.");
+
+                ++tag;
+                if (tag == invalidTag()) { ++tag; }
+                goto again;
+            }
+
+            ++line.refs;
+        }
+
+        ++_totalRefs;
+
+        return tag;
+    }
+
+    const std::vector<Cell> & lookup(Tag tag) const {
+        if (tag != _scratchTag) {
+            auto iter = _lines.find(tag);
+            ASSERT(iter != _lines.end(), "");
+            assemble(iter->second, _scratch);
+            _scratchTag = tag;
+        }
+
+        return _scratch;
+    }
+
+    std::shared_ptr<const std::vector<Cell>> share(Tag UNUSED(tag)) const {
+        return nullptr;                 // always assembled
+    }
+
+    size_t getLength(Tag tag) const {
+        auto iter = _lines.find(tag);
+        ASSERT(iter != _lines.end(), "");
+        return iter->second.size;
+    }
+
+    void remove(Tag tag) {
+        ASSERT(tag != invalidTag(), "");
+        auto iter = _lines.find(tag);
+        ASSERT(iter != _lines.end(), "");
+
+        if (--iter->second.refs == 0) {
+            release(iter);
+        }
+
+        --_totalRefs;
+    }
+
+    void lookupRemove(Tag tag, std::vector<Cell> & cells) {
+        ASSERT(tag != invalidTag(), "");
+        auto iter = _lines.find(tag);
+        ASSERT(iter != _lines.end(), "");
+
+        assemble(iter->second, cells);
+
+        if (--iter->second.refs == 0) {
+            release(iter);
+        }
+
+        --_totalRefs;
+    }
+
+    void getStats(uint32_t & uniqueLines, uint32_t & totalLines) const {
+        uniqueLines = _lines.size();
+        totalLines  = _totalRefs;
+    }
+
+    void getStats2(size_t & bytes1, size_t & bytes2) const {
+        bytes1 = 0;
+        bytes2 = 0;
+
+        for (auto & c : _chunks) {
+            bytes1 += c.second.cells.size() * sizeof(Cell);
+        }
+
+        for (auto & l : _lines) {
+            auto & line = l.second;
+
+            bytes1 += line.chunks.size() * sizeof(ChunkTag);
+            bytes2 += line.refs * line.size * sizeof(Cell);
+        }
+    }
+
+    size_t getBytes() const {
+        return _bytes;
+    }
+
+    bool cool() { return false; }
+
+    void dump(std::ostream & ost) const {
+        ost << "BEGIN GLOBAL TAGS" << std::endl;
+
+        size_t i = 0;
+
+        for (auto & l : _lines) {
+            auto   tag  = l.first;
+            auto & line = l.second;
+
+            ost << std::setw(6) << i << " "
+                << std::setw(sizeof(Tag) * 2) << std::setfill('0')
+                << std::hex << std::uppercase << tag << ": "
+                << std::setw(4) << std::setfill(' ') << std::dec << line.refs << " \'";
+
+            for (auto c : line.chunks) {
+                for (auto & cell : _chunks.find(c)->second.cells) {
+                    ost << cell.seq;
+                }
+                ost << '|';
+            }
+
+            ost << "\'" << std::endl;
+
+            ++i;
+        }
+
+        ost << "END GLOBAL TAGS" << std::endl << std::endl;
+    }
+
+private:
+    // Gear table for the rolling hash, generated deterministically (splitmix32).
+    static const uint32_t * gear() {
+        static uint32_t table[256];
+        static bool     init = false;
+
+        if (!init) {
+            uint32_t x = 0x9E3779B9;
+            for (auto & t : table) {
+                uint32_t z = (x += 0x9E3779B9);
+                z = (z ^ (z >> 16)) * 0x85EBCA6B;
+                z = (z ^ (z >> 13)) * 0xC2B2AE35;
+                t = z ^ (z >> 16);
+            }
+            init = true;
+        }
+
+        return table;
+    }
+
+    static size_t nextBoundary(const std::vector<Cell> & cells, size_t begin) {
+        auto     g   = gear();
+        auto     end = std::min(cells.size(), begin + MAX_CHUNK);
+        uint32_t h   = 0;
+
+        for (auto i = begin; i != end; ++i) {
+            auto fp = hash<SDBM<uint32_t>>(&cells[i], sizeof(Cell));
+            h = (h << 1) + g[(fp ^ (fp >> 16)) & 0xFF];
+
+            if (i + 1 - begin >= MIN_CHUNK && (h & BOUNDARY) == 0) {
+                return i + 1;
+            }
+        }
+
+        return end;
+    }
+
+    ChunkTag findChunk(std::vector<Cell>::const_iterator begin,
+                       std::vector<Cell>::const_iterator end) {
+        auto tag = hash<SDBM<ChunkTag>>(&*begin, sizeof(Cell) * (end - begin));
+
+        for (;;) {
+            auto iter = _chunks.find(tag);
+
+            if (iter == _chunks.end()) {
+                _bytes += sizeof(Cell) * (end - begin);
+                _chunks.insert(std::make_pair(tag, Chunk(begin, end)));
+                return tag;
+            }
+            else if (iter->second.cells.size() == static_cast<size_t>(end - begin) &&
+                     std::equal(begin, end, iter->second.cells.begin())) {
+                return tag;
+            }
+
+            ENFORCE(static_cast<ChunkTag>(_chunks.size()) != static_cast<ChunkTag>(-1),
+                    "No chunk room left.");
+            ++tag;
+        }
+    }
+
+    void assemble(const Line & line, std::vector<Cell> & cells) const {
+        cells.clear();
+        cells.reserve(line.size);
+
+        for (auto c : line.chunks) {
+            auto & chunk = _chunks.find(c)->second.cells;
+            cells.insert(cells.end(), chunk.begin(), chunk.end());
+        }
+
+        ASSERT(cells.size() == line.size, "");
+    }
+
+    void release(std::unordered_map<Tag, Line>::iterator iter) {
+        for (auto c : iter->second.chunks) {
+            auto citer = _chunks.find(c);
+            ASSERT(citer != _chunks.end(), "");
+            if (--citer->second.refs == 0) {
+                _bytes -= citer->second.cells.size() * sizeof(Cell);
+                _chunks.erase(citer);
+            }
+        }
+
+        _bytes -= iter->second.chunks.size() * sizeof(ChunkTag);
+        if (iter->first == _scratchTag) { _scratchTag = invalidTag(); }
+        _lines.erase(iter);
+    }
+
+    static Tag makeTag(const std::vector<ChunkTag> & chunks) {
+        auto tag = chunks.empty() ? Tag(0) :
+            hash<SDBM<Tag>>(&chunks.front(), sizeof(ChunkTag) * chunks.size());
+        if (tag == invalidTag()) { ++tag; }
+        return tag;
+    }
+};
+
+#endif // COMMON__CHUNK_DEDUPER__HXX
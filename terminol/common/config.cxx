@@ -164,6 +164,7 @@ const Color COLOURS_SOLARIZED_LIGHT[16] = {
 Config::Config() :
     fontName("Monospace"),
     fontSize(12),
+    cacheFontMetrics(true),
     termName("xterm-256color"),
     scrollWithHistory(false),
     scrollOnTtyOutput(false),
@@ -175,10 +176,27 @@ Config::Config() :
     chdir(),
     scrollBackHistory(1 * 1024 * 1024),
     unlimitedScrollBack(false),
+    scrollBackBytes(0),
+    globalScrollBackBytes(0),
+    chunkedDedupe(false),
+    spillScrollBack(false),
+    spillDir(),
+    compressScrollBack(false),
+    residentHistoryLines(64 * 1024),
+    residentHistorySeconds(600),
     framesPerSecond(50),
+    backgroundFramesPerSecond(10),
     traditionalWrapping(false),
+    ttyWriteHighWater(64 * 1024),
+    ttyReadBudget(32 * 1024),
+    ttyReaderThread(false),
+    emulationThreads(0),
+    shellPool(0),
+    ioUring(false),
+    lowLatencyEcho(false),
     //
     traceTty(false),
+    traceLatency(false),
     syncTty(false),
     //
     initialX(-1),
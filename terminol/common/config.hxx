@@ -22,6 +22,7 @@ struct Config {
 
     std::string fontName;
     int         fontSize;
+    bool        cacheFontMetrics;       // across runs, under $XDG_CACHE_HOME
     std::string termName;
     bool        scrollWithHistory;
     bool        scrollOnTtyOutput;
@@ -33,10 +34,27 @@ struct Config {
     std::string chdir;
     size_t      scrollBackHistory;
     bool        unlimitedScrollBack;
+    size_t      scrollBackBytes;        // 0 -> no byte limit
+    size_t      globalScrollBackBytes;  // 0 -> no byte limit, server only
+    bool        chunkedDedupe;
+    bool        spillScrollBack;        // cold history to an mmap'ed file
+    std::string spillDir;               // empty -> $XDG_RUNTIME_DIR
+    bool        compressScrollBack;     // cold history compressed in blocks
+    size_t      residentHistoryLines;   // unique lines kept warm
+    uint32_t    residentHistorySeconds; // 0 -> no age limit
     int         framesPerSecond;
+    int         backgroundFramesPerSecond;  // unfocused windows
     bool        traditionalWrapping;
+    size_t      ttyWriteHighWater;      // queued input before backpressure
+    size_t      ttyReadBudget;          // per window per round
+    bool        ttyReaderThread;        // drain the pty on its own thread
+    size_t      emulationThreads;       // terminols: 0 -> parse on the main thread
+    size_t      shellPool;              // terminols: shells started ahead of time
+    bool        ioUring;                // falls back to epoll
+    bool        lowLatencyEcho;         // present key echo without a round trip
     // Debugging support:
     bool        traceTty;
+    bool        traceLatency;           // key press to present
     bool        syncTty;
     //
     int16_t     initialX;
@@ -0,0 +1,149 @@
+// vi:noai:sw=4
+
+#include "terminol/common/control.hxx"
+
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace control {
+
+Packet::Packet(const char * data, size_t size) throw (Error) :
+    _fields(),
+    _next(0)
+{
+    if (size == 0 || data[size - 1] != '\0') { throw Error("Malformed packet."); }
+
+    for (auto end = data + size; data != end; ) {
+        auto length = std::strlen(data);
+        _fields.push_back(std::string(data, length));
+        data += length + 1;
+    }
+}
+
+std::string Packet::encode() const {
+    std::string bytes;
+    for (auto & f : _fields) {
+        bytes += f;
+        bytes += '\0';
+    }
+    return bytes;
+}
+
+void put(Packet & packet, const Create & create) {
+    packet.put(create.count).put(create.rows).put(create.cols).put(create.options.cwd);
+
+    packet.put(create.command.size());
+    for (auto & a : create.command) { packet.put(a); }
+
+    packet.put(create.options.env.size());
+    for (auto & e : create.options.env) { packet.put(e); }
+}
+
+void get(Packet & packet, Create & create) throw (Error) {
+    create.count       = packet.get<uint32_t>();
+    create.rows        = packet.get<uint16_t>();
+    create.cols        = packet.get<uint16_t>();
+    create.options.cwd = packet.get<std::string>();
+
+    create.command.clear();
+    for (auto n = packet.get<size_t>(); n != 0; --n) {
+        create.command.push_back(packet.get<std::string>());
+    }
+
+    create.options.env.clear();
+    for (auto n = packet.get<size_t>(); n != 0; --n) {
+        auto e = packet.get<std::string>();
+        if (e.find('=') == std::string::npos) { throw Error("Not NAME=VALUE: " + e); }
+        create.options.env.push_back(e);
+    }
+}
+
+void put(Packet & packet, const Stats & stats) {
+    packet.put(stats.uniqueLines).put(stats.totalLines);
+    packet.put(stats.storedBytes).put(stats.cellBytes);
+
+    packet.put(stats.windows.size());
+    for (auto & w : stats.windows) {
+        packet.put(w.id).put(w.bytesParsed).put(w.framesDrawn);
+        packet.put(w.historyLines).put(w.historyBytes);
+    }
+}
+
+void get(Packet & packet, Stats & stats) throw (Error) {
+    stats.uniqueLines = packet.get<uint32_t>();
+    stats.totalLines  = packet.get<uint32_t>();
+    stats.storedBytes = packet.get<uint64_t>();
+    stats.cellBytes   = packet.get<uint64_t>();
+
+    stats.windows.clear();
+    for (auto n = packet.get<size_t>(); n != 0; --n) {
+        WindowStats w;
+        w.id           = packet.get<uint32_t>();
+        w.bytesParsed  = packet.get<uint64_t>();
+        w.framesDrawn  = packet.get<uint64_t>();
+        w.historyLines = packet.get<uint32_t>();
+        w.historyBytes = packet.get<uint64_t>();
+        stats.windows.push_back(w);
+    }
+}
+
+int connect(const std::string & path) throw (Error) {
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof address.sun_path) {
+        throw Error("Socket path too long: " + path);
+    }
+    path.copy(address.sun_path, path.size());
+
+    auto fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    ENFORCE_SYS(fd != -1, "::socket() failed.");
+
+    if (TEMP_FAILURE_RETRY(::connect(fd, reinterpret_cast<struct sockaddr *>(&address),
+                                     sizeof address)) == -1) {
+        auto error = errno;
+        ENFORCE_SYS(::close(fd) != -1, "");
+        throw Error("Failed to connect to " + path + ": " + ::strerror(error));
+    }
+
+    return fd;
+}
+
+bool receive(int fd, Packet & packet) throw (Error) {
+    std::vector<char> buffer(MAX_PACKET);
+
+    // MSG_TRUNC: the real size, even if it didn't fit.
+    auto rval = TEMP_FAILURE_RETRY(::recv(fd, &buffer.front(), buffer.size(), MSG_TRUNC));
+
+    if (rval == -1) {
+        if (errno == ECONNRESET) { return false; }
+        throw Error(std::string("Failed to receive: ") + ::strerror(errno));
+    }
+    else if (rval == 0) {
+        return false;
+    }
+    else if (static_cast<size_t>(rval) > buffer.size()) {
+        throw Error("Packet too large: " + stringify(rval));
+    }
+
+    packet = Packet(&buffer.front(), rval);
+    return true;
+}
+
+void send(int fd, const Packet & packet) throw (Error) {
+    auto bytes = packet.encode();
+
+    if (bytes.size() > MAX_PACKET) {
+        throw Error("Packet too large: " + stringify(bytes.size()));
+    }
+
+    if (TEMP_FAILURE_RETRY(::send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL)) == -1) {
+        throw Error(std::string("Failed to send: ") + ::strerror(errno));
+    }
+}
+
+} // namespace control
@@ -0,0 +1,106 @@
+// vi:noai:sw=4
+
+#ifndef COMMON__CONTROL__HXX
+#define COMMON__CONTROL__HXX
+
+#include "terminol/common/tty.hxx"
+#include "terminol/support/conv.hxx"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+//
+// How terminolc talks to terminols. The server listens on a Unix domain
+// SOCK_SEQPACKET socket at the socket path. Each request and each reply
+// is exactly one packet, so there is no framing to get wrong and no
+// partial reads. A packet is a list of NUL terminated fields, the first
+// naming the request ("create", "stats" or "shutdown") or the outcome
+// ("ok" or "error", followed by the message). A client may send many
+// requests on one connection; each gets its reply in order.
+//
+
+namespace control {
+
+const size_t MAX_PACKET = 128 * 1024;
+
+struct Error {
+    explicit Error(const std::string & message_) : message(message_) {}
+    std::string message;
+};
+
+// Open count windows, all alike. Replied to with their ids.
+struct Create {
+    Create() : count(1), rows(0), cols(0), command(), options() {}
+
+    uint32_t     count;
+    uint16_t     rows;          // 0 -> initial-rows
+    uint16_t     cols;          // 0 -> initial-cols
+    Tty::Command command;       // empty -> the user's shell
+    Tty::Options options;
+};
+
+struct WindowStats {
+    uint32_t id;
+    uint64_t bytesParsed;
+    uint64_t framesDrawn;
+    uint32_t historyLines;
+    uint64_t historyBytes;
+};
+
+// The history of all windows goes through one deduper, so the line and
+// byte counts (and the ratio between them) are for the server as a whole.
+struct Stats {
+    uint32_t                 uniqueLines;
+    uint32_t                 totalLines;
+    uint64_t                 storedBytes;
+    uint64_t                 cellBytes;
+    std::vector<WindowStats> windows;
+};
+
+class Packet {
+    std::vector<std::string> _fields;
+    size_t                   _next;         // for get()
+
+public:
+    Packet() : _fields(), _next(0) {}
+    Packet(const char * data, size_t size) throw (Error);
+
+    std::string encode() const;
+
+    bool atEnd() const { return _next == _fields.size(); }
+
+    template <typename T> Packet & put(const T & value) {
+        _fields.push_back(stringify(value));
+        return *this;
+    }
+
+    template <typename T> T get() throw (Error) {
+        if (atEnd()) { throw Error("Truncated packet."); }
+        try {
+            return unstringify<T>(_fields[_next++]);
+        }
+        catch (const ParseError & ex) {
+            throw Error("Bad field: " + ex.message);
+        }
+    }
+};
+
+void put(Packet & packet, const Create & create);
+void get(Packet & packet, Create & create) throw (Error);
+
+void put(Packet & packet, const Stats & stats);
+void get(Packet & packet, Stats & stats) throw (Error);
+
+// Blocking, for clients.
+int  connect(const std::string & path) throw (Error);
+
+// Returns false if the peer has gone. A packet that doesn't fit in
+// MAX_PACKET is an error.
+bool receive(int fd, Packet & packet) throw (Error);
+void send(int fd, const Packet & packet) throw (Error);
+
+} // namespace control
+
+#endif // COMMON__CONTROL__HXX
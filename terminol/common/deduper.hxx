@@ -4,10 +4,17 @@
 #define COMMON__DEDUPER__HXX
 
 #include "terminol/common/deduper_interface.hxx"
+#include "terminol/common/spill_store.hxx"
 #include "terminol/support/escape.hxx"
+#include "terminol/support/time.hxx"
+#include "terminol/support/lz.hxx"
 
 #include <unordered_map>
+#include <deque>
+#include <list>
+#include <memory>
 #include <algorithm>
+#include <numeric>
 #include <vector>
 #include <iostream>
 #include <iomanip>
@@ -30,23 +37,105 @@ template <class A> typename A::Type hash(const void * buffer,
 } // namespace {anonymous}
 
 //
-//
+// Lines that have been stored the longest (by count or by age) can be
+// moved to cold storage by cool(): either spilled to a SpillStore, or
+// compressed in blocks of BLOCK_LINES lines. Storing a line again makes it
+// the newest, so lines that keep being deduped stay warm. Warm lines are
+// held by shared pointer, so share() can hand one out that outlives its
+// cooling or removal. A cold line is copied into a scratch buffer on
+// lookup, so that reference is only valid until the next call. Recently
+// used blocks are kept decompressed in a small LRU. getBytes() counts
+// only memory: compressed blocks, but not spilled lines.
 //
 
 class Deduper : public I_Deduper {
+    static const size_t BLOCK_LINES  = 64;
+    static const size_t CACHE_BLOCKS = 16;
+    static const size_t COOL_ENTRIES = 1024;    // looked at per cool()
+
+    enum class Where { MEMORY, SPILLED, COMPRESSED };
+
+    typedef std::shared_ptr<std::vector<Cell>> Cells;
+
     struct Payload {
-        std::vector<Cell> cells;
+        Cells             cells;        // null unless MEMORY
         uint32_t          refs;
+        Where             where;
+        uint32_t          block;        // SPILLED: segment, COMPRESSED: block
+        uint32_t          offset;       // cells, within the segment or block
+        uint32_t          length;       // cells, unless MEMORY
+        uint64_t          generation;   // of its live Resident, 0 -> none
+
+        Payload(std::vector<Cell> & cells_) :
+            cells(std::make_shared<std::vector<Cell>>(std::move(cells_))),
+            refs(1), where(Where::MEMORY),
+            block(0), offset(0), length(0), generation(0) {}
+
+        size_t size() const { return where == Where::MEMORY ? cells->size() : length; }
+
+        SpillStore::Ref ref() const {
+            SpillStore::Ref r;
+            r.segment = block;
+            r.offset  = offset;
+            r.size    = length;
+            return r;
+        }
+    };
+
+    // An entry goes stale when its line is stored again (a newer entry
+    // supersedes it) or goes away, and is then skipped.
+    struct Resident {
+        Tag      tag;
+        uint64_t generation;
+        uint64_t time;                  // us
+    };
 
-        Payload(std::vector<Cell> & cells_) : cells(std::move(cells_)), refs(1) {}
+    struct Block {
+        std::vector<uint8_t> data;      // lz compressed cells
+        uint32_t             cells;
+        uint32_t             lines;     // payloads still in this block
     };
 
-    std::unordered_map<Tag, Payload> _lines;
-    size_t                           _totalRefs;
+    typedef std::list<std::pair<uint32_t, std::vector<Cell>>> Cache;
+
+    std::unordered_map<Tag, Payload>        _lines;
+    size_t                                  _totalRefs;
+    size_t                                  _bytes;             // in memory
+
+    std::unique_ptr<SpillStore>             _spillStore;        // may be null
+    bool                                    _compress;
+    bool                                    _tracking;          // lines may go cold
+    size_t                                  _residentLines;
+    uint64_t                                _residentTime;      // us, 0 -> no limit
+    std::deque<Resident>                    _resident;          // in store order
+    uint64_t                                _generation;
+    size_t                                  _warm;              // live Residents
+    std::vector<Tag>                        _cooling;           // awaiting a block
+    std::unordered_map<uint32_t, Block>     _blocks;
+    uint32_t                                _nextBlock;
+    mutable Cache                           _cache;
+    mutable std::vector<Cell>               _scratch;
 
 public:
-    Deduper() : _lines(), _totalRefs(0) {}
-    virtual ~Deduper() {}
+    Deduper() :
+        _lines(), _totalRefs(0), _bytes(0),
+        _spillStore(nullptr), _compress(false), _tracking(false),
+        _residentLines(0), _residentTime(0), _resident(), _generation(0), _warm(0),
+        _cooling(), _blocks(), _nextBlock(0), _cache(), _scratch() {}
+
+    // Adopts spillStore. Compression takes precedence over spilling.
+    Deduper(SpillStore * spillStore, bool compress,
+            size_t residentLines, uint32_t residentSeconds) :
+        _lines(), _totalRefs(0), _bytes(0),
+        _spillStore(spillStore), _compress(compress), _tracking(spillStore || compress),
+        _residentLines(residentLines),
+        _residentTime(static_cast<uint64_t>(residentSeconds) * 1000000),
+        _resident(), _generation(0), _warm(0),
+        _cooling(), _blocks(), _nextBlock(0), _cache(), _scratch() {}
+
+    virtual ~Deduper() {
+        _lines.clear();
+    }
 
     Tag store(std::vector<Cell> & cells) {
         auto tag = makeTag(cells);
@@ -56,12 +145,15 @@ again:
         auto iter = _lines.find(tag);
 
         if (iter == _lines.end()) {
-            _lines.insert(std::make_pair(tag, Payload(cells)));
+            _bytes += cells.size() * sizeof(Cell);
+            auto & payload = _lines.insert(std::make_pair(tag, Payload(cells))).first->second;
+
+            if (_tracking) { touch(tag, payload); }
         }
         else {
             auto & payload = iter->second;
 
-            if (cells != payload.cells) {
+            if (cells != cellsOf(payload)) {
 #if 0
                 std::cerr << "Hash collision:" << std::endl;
 
@@ -72,7 +164,7 @@ again:
                 std::cerr << "\'" << std::endl;
 
                 std::cerr << "  \'";
-                for (auto & c : payload.cells) {
+                for (auto & c : *payload.cells) {
                     std::cerr << c.seq;
                 }
                 std::cerr << "\'" << std::endl;
@@ -86,6 +178,12 @@ again:
             }
 
             ++payload.refs;
+
+            if (_tracking && payload.where == Where::MEMORY &&
+                payload.generation != _generation)
+            {
+                touch(tag, payload);
+            }
         }
 
         ++_totalRefs;
@@ -94,11 +192,23 @@ again:
     }
 
     const std::vector<Cell> & lookup(Tag tag) const {
+        auto iter = _lines.find(tag);
+        ASSERT(iter != _lines.end(), "");
+        return cellsOf(iter->second);
+    }
+
+    std::shared_ptr<const std::vector<Cell>> share(Tag tag) const {
         auto iter = _lines.find(tag);
         ASSERT(iter != _lines.end(), "");
         return iter->second.cells;
     }
 
+    size_t getLength(Tag tag) const {
+        auto iter = _lines.find(tag);
+        ASSERT(iter != _lines.end(), "");
+        return iter->second.size();
+    }
+
     void remove(Tag tag) {
         ASSERT(tag != invalidTag(), "");
         auto iter = _lines.find(tag);
@@ -106,7 +216,7 @@ again:
         auto & payload = iter->second;
 
         if (--payload.refs == 0) {
-            _lines.erase(iter);
+            release(iter);
         }
 
         --_totalRefs;
@@ -118,13 +228,23 @@ again:
         ASSERT(iter != _lines.end(), "");
         auto & payload = iter->second;
 
-        if (--payload.refs == 0) {
-            cells = std::move(payload.cells);
-            ASSERT(payload.cells.empty(), "");
+        if (payload.where != Where::MEMORY) {
+            cells = cellsOf(payload);
+
+            if (--payload.refs == 0) {
+                release(iter);
+            }
+        }
+        else if (--payload.refs == 0) {
+            if (payload.generation != 0) { --_warm; }
+            _bytes -= payload.cells->size() * sizeof(Cell);
+            // It may have been shared.
+            if (payload.cells.unique()) { cells = std::move(*payload.cells); }
+            else                        { cells = *payload.cells; }
             _lines.erase(iter);
         }
         else {
-            cells = payload.cells;
+            cells = *payload.cells;
         }
 
         --_totalRefs;
@@ -142,11 +262,82 @@ again:
         for (auto & l : _lines) {
             auto & payload = l.second;
 
-            size_t size = payload.cells.size() * sizeof(Cell);
+            size_t size = payload.size() * sizeof(Cell);
 
-            bytes1 += size;
+            if (payload.where == Where::MEMORY) { bytes1 += size; }
             bytes2 += payload.refs * size;
         }
+
+        for (auto & b : _blocks) {
+            bytes1 += b.second.data.size();
+        }
+    }
+
+    size_t getBytes() const {
+        return _bytes;
+    }
+
+    // Move some of the lines that are no longer resident to cold storage,
+    // at most a block's worth so that a call stays short. Returns true if
+    // there may be more. Called from a timer, not from store(), to keep it
+    // off the hot path.
+    bool cool() {
+        if (!_tracking) { return false; }
+
+        auto   now      = _residentTime != 0 ? monotonicMicroseconds() : 0;
+        size_t examined = 0;
+        size_t cooled   = 0;
+
+        while (!_resident.empty()) {
+            if (examined++ == COOL_ENTRIES || cooled == BLOCK_LINES) { return true; }
+
+            auto & front = _resident.front();
+            auto   iter  = _lines.find(front.tag);
+
+            if (iter == _lines.end() || iter->second.generation != front.generation) {
+                _resident.pop_front();
+                continue;
+            }
+
+            if (_warm <= _residentLines &&
+                (_residentTime == 0 || now - front.time <= _residentTime))
+            {
+                break;
+            }
+
+            _resident.pop_front();
+
+            auto & payload = iter->second;
+            ASSERT(payload.where == Where::MEMORY, "");
+            payload.generation = 0;
+            --_warm;
+            ++cooled;
+
+            if (_compress) {
+                _cooling.push_back(iter->first);
+                if (_cooling.size() == BLOCK_LINES) {
+                    compressBlock();
+                    return true;
+                }
+            }
+            else if (!spill(payload)) {
+                return false;
+            }
+        }
+
+        // Lines that stay warm leave stale entries behind the front.
+        if (_resident.size() > 2 * _warm + BLOCK_LINES) {
+            std::deque<Resident> live;
+            for (auto & r : _resident) {
+                auto iter = _lines.find(r.tag);
+                if (iter != _lines.end() && iter->second.generation == r.generation) {
+                    live.push_back(r);
+                }
+            }
+            _resident.swap(live);
+        }
+
+        return false;
     }
 
     void dump(std::ostream & ost) const {
@@ -163,7 +354,7 @@ again:
                 << std::hex << std::uppercase << tag << ": "
                 << std::setw(4) << std::setfill(' ') << std::dec << payload.refs << " \'";
 
-            for (auto & c : payload.cells) {
+            for (auto & c : cellsOf(payload)) {
                 ost << c.seq;
             }
 
@@ -176,6 +367,152 @@ again:
     }
 
 private:
+    const std::vector<Cell> & cellsOf(const Payload & payload) const {
+        switch (payload.where) {
+            case Where::MEMORY:
+                return *payload.cells;
+            case Where::SPILLED:
+                _spillStore->read(payload.ref(), _scratch);
+                return _scratch;
+            case Where::COMPRESSED: {
+                auto & cells = blockCells(payload.block);
+                _scratch.assign(cells.begin() + payload.offset,
+                                cells.begin() + payload.offset + payload.length);
+                return _scratch;
+            }
+        }
+
+        FATAL("Unreachable");
+    }
+
+    const std::vector<Cell> & blockCells(uint32_t id) const {
+        for (auto i = _cache.begin(); i != _cache.end(); ++i) {
+            if (i->first == id) {
+                _cache.splice(_cache.begin(), _cache, i);
+                return i->second;
+            }
+        }
+
+        auto iter = _blocks.find(id);
+        ASSERT(iter != _blocks.end(), "");
+        auto & block = iter->second;
+
+        std::vector<Cell> cells(block.cells, Cell::blank());
+        ENFORCE(lz::decompress(block.data.data(), block.data.size(),
+                               reinterpret_cast<uint8_t *>(cells.data()),
+                               cells.size() * sizeof(Cell)),
+                "Corrupt history block: " << id);
+
+        _cache.push_front(std::make_pair(id, std::move(cells)));
+        if (_cache.size() > CACHE_BLOCKS) { _cache.pop_back(); }
+
+        return _cache.front().second;
+    }
+
+    bool spill(Payload & payload) {
+        ASSERT(payload.where == Where::MEMORY, "");
+
+        try {
+            auto ref = _spillStore->append(*payload.cells);
+            payload.block  = ref.segment;
+            payload.offset = ref.offset;
+            payload.length = ref.size;
+        }
+        catch (const SpillStore::Error & ex) {
+            ERROR(ex.message << ", no longer spilling.");
+            _tracking = false;
+            _resident.clear();
+            return false;
+        }
+
+        // On disk now, so it no longer counts against a memory budget.
+        _bytes -= payload.cells->size() * sizeof(Cell);
+
+        payload.where = Where::SPILLED;
+        payload.cells.reset();
+
+        return true;
+    }
+
+    void compressBlock() {
+        auto              id = _nextBlock++;
+        std::vector<Cell> cells;
+        uint32_t          lines = 0;
+
+        for (auto tag : _cooling) {
+            // Gone, stored again since, or already in a block.
+            auto iter = _lines.find(tag);
+            if (iter == _lines.end() || iter->second.generation != 0 ||
+                iter->second.where != Where::MEMORY) { continue; }
+
+            auto & payload = iter->second;
+            _bytes -= payload.cells->size() * sizeof(Cell);
+
+            payload.where  = Where::COMPRESSED;
+            payload.block  = id;
+            payload.offset = cells.size();
+            payload.length = payload.cells->size();
+            cells.insert(cells.end(), payload.cells->begin(), payload.cells->end());
+            payload.cells.reset();
+
+            ++lines;
+        }
+
+        _cooling.clear();
+
+        if (lines != 0) {
+            Block block;
+            block.cells = cells.size();
+            block.lines = lines;
+            lz::compress(reinterpret_cast<const uint8_t *>(cells.data()),
+                         cells.size() * sizeof(Cell), block.data);
+            block.data.shrink_to_fit();
+
+            _bytes += block.data.size();
+            _blocks.insert(std::make_pair(id, std::move(block)));
+        }
+    }
+
+    // Makes the payload the newest resident line.
+    void touch(Tag tag, Payload & payload) {
+        if (payload.generation == 0) { ++_warm; }
+        payload.generation = ++_generation;
+
+        Resident resident = { tag, payload.generation, monotonicMicroseconds() };
+        _resident.push_back(resident);
+    }
+
+    void release(std::unordered_map<Tag, Payload>::iterator iter) {
+        auto & payload = iter->second;
+
+        if (payload.generation != 0) { --_warm; }
+
+        switch (payload.where) {
+            case Where::MEMORY:
+                _bytes -= payload.cells->size() * sizeof(Cell);
+                break;
+            case Where::SPILLED:
+                _spillStore->release(payload.ref());
+                break;
+            case Where::COMPRESSED: {
+                auto biter = _blocks.find(payload.block);
+                ASSERT(biter != _blocks.end(), "");
+
+                if (--biter->second.lines == 0) {
+                    _bytes -= biter->second.data.size();
+                    _blocks.erase(biter);
+
+                    for (auto i = _cache.begin(); i != _cache.end(); ++i) {
+                        if (i->first == payload.block) { _cache.erase(i); break; }
+                    }
+                }
+                break;
+            }
+        }
+
+        _lines.erase(iter);
+    }
+
     static Tag makeTag(const std::vector<Cell> & cells) {
         auto tag = hash<SDBM<Tag>>(&cells.front(), sizeof(Cell) * cells.size());
         if (tag == invalidTag()) { ++tag; }
@@ -5,6 +5,7 @@
 
 #include "terminol/common/data_types.hxx"
 
+#include <memory>
 #include <vector>
 
 class I_Deduper {
@@ -14,10 +15,18 @@ public:
 
     virtual Tag store(std::vector<Cell> & cells) = 0;
     virtual const std::vector<Cell> & lookup(Tag tag) const = 0;
+    // The line's cells without copying them, or nullptr if they would have
+    // to be fetched or assembled. Unlike lookup() it never changes the
+    // deduper, and the cells stay good for as long as they're held.
+    virtual std::shared_ptr<const std::vector<Cell>> share(Tag tag) const = 0;
+    virtual size_t getLength(Tag tag) const = 0;  // In cells, without fetching them.
     virtual void remove(Tag tag) = 0;
     virtual void lookupRemove(Tag tag, std::vector<Cell> & cells) = 0;
     virtual void getStats(uint32_t & uniqueLines, uint32_t & totalLines) const = 0;
     virtual void getStats2(size_t & bytes1, size_t & bytes2) const = 0;
+    virtual size_t getBytes() const = 0;        // Same as bytes1, but cheap.
+    virtual bool cool() = 0;                    // Idle time housekeeping, a step
+                                                // at a time. True if there's more.
     virtual void dump(std::ostream & ost) const = 0;
 
 protected:
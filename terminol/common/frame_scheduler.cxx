@@ -0,0 +1,115 @@
+// vi:noai:sw=4
+
+#include "terminol/common/frame_scheduler.hxx"
+#include "terminol/support/time.hxx"
+
+#include <algorithm>
+#include <limits>
+
+FrameScheduler::FrameScheduler(I_Selector & selector, int framesPerSecond,
+                               int backgroundFramesPerSecond) :
+    _selector(selector),
+    _interval(1000000 / std::max(framesPerSecond, 1)),
+    _backgroundInterval(1000000 / std::max(std::min(backgroundFramesPerSecond,
+                                                    framesPerSecond), 1)),
+    _waiting(),
+    _background(),
+    _drawing(),
+    _timer(-1),
+    _ticking(false),
+    _lastTick(0),
+    _due(0) {}
+
+FrameScheduler::~FrameScheduler() {
+    if (_timer != -1) {
+        _selector.removeTimer(_timer);
+    }
+}
+
+bool FrameScheduler::admit(I_Client * client, bool urgent, bool background) {
+    if (urgent) {
+        // Whatever it was waiting for gets drawn now too.
+        _waiting.erase(client);
+        _background.erase(client);
+        return true;
+    }
+
+    auto now = monotonicMicroseconds();
+
+    if (!background) {
+        // Promoted: no need to wait out the slow clock.
+        _background.erase(client);
+        _waiting.insert(client);
+    }
+    else if (_waiting.find(client) == _waiting.end()) {
+        // An earlier admission keeps its due time.
+        _background.insert(std::make_pair(client, now + _backgroundInterval));
+    }
+
+    schedule(now);
+
+    return false;
+}
+
+void FrameScheduler::remove(I_Client * client) {
+    _waiting.erase(client);
+    _background.erase(client);
+    _drawing.erase(client);
+}
+
+void FrameScheduler::schedule(uint64_t now) {
+    auto due = std::numeric_limits<uint64_t>::max();
+    if (!_waiting.empty()) { due = now; }
+    for (auto & p : _background) { due = std::min(due, p.second); }
+
+    // Keep to the clock: no sooner than an interval after the last tick.
+    // Nor in the past, which a slow frame can leave a background client.
+    due = std::max(due, _lastTick + _interval);
+    due = std::max(due, now);
+
+    // Only ever brought forward, an armed timer isn't worth touching.
+    if (_ticking && due >= _due) { return; }
+    _due = due;
+
+    auto milliseconds = static_cast<uint32_t>((due - now + 999) / 1000);
+
+    if (_timer == -1) {
+        _timer = _selector.addTimer(this, milliseconds, false);
+    }
+    else {
+        _selector.armTimer(_timer, milliseconds);
+    }
+
+    _ticking = true;
+}
+
+// I_Selector::I_TimerHandler implementation:
+
+void FrameScheduler::handleTimer(int timer) throw () {
+    ASSERT(timer == _timer, "");
+    _ticking  = false;
+    _lastTick = monotonicMicroseconds();
+
+    _drawing.swap(_waiting);
+
+    for (auto i = _background.begin(); i != _background.end(); ) {
+        if (i->second <= _lastTick) {
+            _drawing.insert(i->first);
+            i = _background.erase(i);
+        }
+        else {
+            ++i;
+        }
+    }
+
+    // A frame may remove another client, so take them one at a time.
+    while (!_drawing.empty()) {
+        auto client = *_drawing.begin();
+        _drawing.erase(_drawing.begin());
+        client->frameDue();
+    }
+
+    if (!_waiting.empty() || !_background.empty()) {
+        schedule(monotonicMicroseconds());
+    }
+}
@@ -0,0 +1,69 @@
+// vi:noai:sw=4
+
+#ifndef COMMON__FRAME_SCHEDULER__HXX
+#define COMMON__FRAME_SCHEDULER__HXX
+
+#include "terminol/support/selector.hxx"
+#include "terminol/support/pattern.hxx"
+
+#include <map>
+#include <set>
+
+//
+// A frame clock shared by the windows of an event loop. Syncs from the
+// tty only accumulate damage: the client is called back on the next
+// tick, and ticks are at least a frame interval apart. The clock is a
+// one-shot timer that is only re-armed while there is damage, so idle
+// windows cost no wakeups. The exception is the echo of a key press,
+// which is drawn immediately so typing feels no different. Background
+// clients (unfocused windows) are held to a slower clock of their own:
+// each is drawn a background interval after it was first admitted.
+//
+
+class FrameScheduler :
+    protected I_Selector::I_TimerHandler,
+    protected Uncopyable
+{
+public:
+    class I_Client {
+    public:
+        virtual void frameDue() throw () = 0;
+
+    protected:
+        I_Client() {}
+        ~I_Client() {}
+    };
+
+private:
+    I_Selector           & _selector;
+    uint64_t               _interval;      // microseconds
+    uint64_t               _backgroundInterval;
+    std::set<I_Client *>   _waiting;       // for the next tick
+    std::map<I_Client *,
+             uint64_t>     _background;    // waiting, -> when due
+    std::set<I_Client *>   _drawing;       // on this tick
+    int                    _timer;         // -1 until first needed
+    bool                   _ticking;       // is the timer armed?
+    uint64_t               _lastTick;      // monotonicMicroseconds()
+    uint64_t               _due;           // of the armed timer
+
+public:
+    FrameScheduler(I_Selector & selector, int framesPerSecond,
+                   int backgroundFramesPerSecond);
+    virtual ~FrameScheduler();
+
+    // Returns true if the client may draw now (urgent is honoured
+    // immediately), otherwise it will get frameDue() on the next tick,
+    // or on the first tick it is due if it is in the background.
+    bool admit(I_Client * client, bool urgent, bool background = false);
+    void remove(I_Client * client);
+
+protected:
+    void schedule(uint64_t now);
+
+    // I_Selector::I_TimerHandler implementation:
+
+    void handleTimer(int timer) throw ();
+};
+
+#endif // COMMON__FRAME_SCHEDULER__HXX
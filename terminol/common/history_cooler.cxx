@@ -0,0 +1,49 @@
+// vi:noai:sw=4
+
+#include "terminol/common/history_cooler.hxx"
+
+namespace {
+
+const uint32_t DELAY_MS = 100;      // after activity
+const uint32_t STEP_MS  = 1;        // between steps
+
+} // namespace {anonymous}
+
+HistoryCooler::HistoryCooler(I_Selector & selector, I_Deduper & deduper) :
+    _selector(selector),
+    _deduper(deduper),
+    _timer(-1),
+    _armed(false),
+    _ran(false)
+{
+    _timer = _selector.addTimer(this, DELAY_MS, false);
+    _armed = true;
+}
+
+HistoryCooler::~HistoryCooler() {
+    _selector.removeTimer(_timer);
+}
+
+void HistoryCooler::poke() {
+    if (_ran) {
+        _ran = false;
+    }
+    else if (!_armed) {
+        _selector.armTimer(_timer, DELAY_MS);
+        _armed = true;
+    }
+}
+
+// I_Selector::I_TimerHandler implementation:
+
+void HistoryCooler::handleTimer(int timer) throw () {
+    ASSERT(timer == _timer, "");
+
+    if (_deduper.cool()) {
+        _selector.armTimer(_timer, STEP_MS);
+    }
+    else {
+        _armed = false;
+        _ran   = true;
+    }
+}
@@ -0,0 +1,40 @@
+// vi:noai:sw=4
+
+#ifndef COMMON__HISTORY_COOLER__HXX
+#define COMMON__HISTORY_COOLER__HXX
+
+#include "terminol/common/deduper_interface.hxx"
+#include "terminol/support/selector.hxx"
+#include "terminol/support/pattern.hxx"
+
+//
+// Moves cold history out of the way a step at a time, from a one-shot
+// timer, so that compressing or spilling never holds up an event loop
+// round. The loop pokes it after each wakeup; it runs a little later
+// and keeps stepping while the deduper has more to do. Its own runs
+// don't count as activity, so an idle loop costs no wakeups.
+//
+
+class HistoryCooler :
+    protected I_Selector::I_TimerHandler,
+    protected Uncopyable
+{
+    I_Selector & _selector;
+    I_Deduper  & _deduper;
+    int          _timer;
+    bool         _armed;
+    bool         _ran;          // since the last poke
+
+public:
+    HistoryCooler(I_Selector & selector, I_Deduper & deduper);
+    virtual ~HistoryCooler();
+
+    void poke();
+
+protected:
+    // I_Selector::I_TimerHandler implementation:
+
+    void handleTimer(int timer) throw ();
+};
+
+#endif // COMMON__HISTORY_COOLER__HXX
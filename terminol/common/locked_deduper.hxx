@@ -0,0 +1,126 @@
+// vi:noai:sw=4
+
+#ifndef COMMON__LOCKED_DEDUPER__HXX
+#define COMMON__LOCKED_DEDUPER__HXX
+
+#include "terminol/common/deduper_interface.hxx"
+#include "terminol/support/debug.hxx"
+#include "terminol/support/pattern.hxx"
+
+#include <pthread.h>
+
+//
+// Lets Buffers on worker threads share one deduper, behind a reader/writer
+// lock. A lookup of a warm line takes the read lock and shares the cells
+// rather than copying them; the thread holds on to them until its next
+// lookup, so the reference stays good even if another thread cools or
+// removes the line meanwhile. Cold lines (and chunked ones) are fetched
+// under the write lock and copied, which their fetch does anyway. Writers
+// are preferred, so the workers' stores don't queue behind a redraw.
+//
+
+class LockedDeduper : public I_Deduper, protected Uncopyable {
+    class ReadLock : protected Uncopyable {
+        pthread_rwlock_t & _lock;
+    public:
+        explicit ReadLock(pthread_rwlock_t & lock) : _lock(lock) {
+            ENFORCE(::pthread_rwlock_rdlock(&_lock) == 0, "");
+        }
+        ~ReadLock() { ::pthread_rwlock_unlock(&_lock); }
+    };
+
+    class WriteLock : protected Uncopyable {
+        pthread_rwlock_t & _lock;
+    public:
+        explicit WriteLock(pthread_rwlock_t & lock) : _lock(lock) {
+            ENFORCE(::pthread_rwlock_wrlock(&_lock) == 0, "");
+        }
+        ~WriteLock() { ::pthread_rwlock_unlock(&_lock); }
+    };
+
+    I_Deduper                & _deduper;
+    mutable pthread_rwlock_t   _lock;
+
+public:
+    explicit LockedDeduper(I_Deduper & deduper) : _deduper(deduper), _lock() {
+        pthread_rwlockattr_t attr;
+        ENFORCE(::pthread_rwlockattr_init(&attr) == 0, "");
+        ::pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        ENFORCE(::pthread_rwlock_init(&_lock, &attr) == 0, "");
+        ::pthread_rwlockattr_destroy(&attr);
+    }
+
+    virtual ~LockedDeduper() {
+        ::pthread_rwlock_destroy(&_lock);
+    }
+
+    // I_Deduper implementation:
+
+    Tag store(std::vector<Cell> & cells) {
+        WriteLock lock(_lock);
+        return _deduper.store(cells);
+    }
+
+    const std::vector<Cell> & lookup(Tag tag) const {
+        static thread_local std::shared_ptr<const std::vector<Cell>> held;
+
+        {
+            ReadLock lock(_lock);
+            held = _deduper.share(tag);
+        }
+
+        if (!held) {
+            WriteLock lock(_lock);
+            held = std::make_shared<const std::vector<Cell>>(_deduper.lookup(tag));
+        }
+
+        return *held;
+    }
+
+    std::shared_ptr<const std::vector<Cell>> share(Tag tag) const {
+        ReadLock lock(_lock);
+        return _deduper.share(tag);
+    }
+
+    size_t getLength(Tag tag) const {
+        ReadLock lock(_lock);
+        return _deduper.getLength(tag);
+    }
+
+    void remove(Tag tag) {
+        WriteLock lock(_lock);
+        _deduper.remove(tag);
+    }
+
+    void lookupRemove(Tag tag, std::vector<Cell> & cells) {
+        WriteLock lock(_lock);
+        _deduper.lookupRemove(tag, cells);
+    }
+
+    void getStats(uint32_t & uniqueLines, uint32_t & totalLines) const {
+        ReadLock lock(_lock);
+        _deduper.getStats(uniqueLines, totalLines);
+    }
+
+    void getStats2(size_t & bytes1, size_t & bytes2) const {
+        ReadLock lock(_lock);
+        _deduper.getStats2(bytes1, bytes2);
+    }
+
+    size_t getBytes() const {
+        ReadLock lock(_lock);
+        return _deduper.getBytes();
+    }
+
+    bool cool() {
+        WriteLock lock(_lock);
+        return _deduper.cool();
+    }
+
+    void dump(std::ostream & ost) const {
+        WriteLock lock(_lock);          // fetches cold lines
+        _deduper.dump(ost);
+    }
+};
+
+#endif // COMMON__LOCKED_DEDUPER__HXX
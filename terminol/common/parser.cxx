@@ -29,6 +29,9 @@ void handleSet(const std::string & key,
     else if (key == "font-size") {
         config.fontSize = unstringify<int>(value);
     }
+    else if (key == "cache-font-metrics") {
+        config.cacheFontMetrics = unstringify<bool>(value);
+    }
     else if (key == "term-name") {
         config.termName = value;
     }
@@ -62,12 +65,63 @@ void handleSet(const std::string & key,
     else if (key == "unlimited-scroll-back") {
         config.unlimitedScrollBack = unstringify<bool>(value);
     }
+    else if (key == "scroll-back-bytes") {
+        config.scrollBackBytes = unhumanSize(value);
+    }
+    else if (key == "global-scroll-back-bytes") {
+        config.globalScrollBackBytes = unhumanSize(value);
+    }
+    else if (key == "chunked-dedupe") {
+        config.chunkedDedupe = unstringify<bool>(value);
+    }
+    else if (key == "spill-scroll-back") {
+        config.spillScrollBack = unstringify<bool>(value);
+    }
+    else if (key == "spill-dir") {
+        config.spillDir = value;
+    }
+    else if (key == "compress-scroll-back") {
+        config.compressScrollBack = unstringify<bool>(value);
+    }
+    else if (key == "resident-history-lines") {
+        config.residentHistoryLines = unstringify<size_t>(value);
+    }
+    else if (key == "resident-history-seconds") {
+        config.residentHistorySeconds = unstringify<uint32_t>(value);
+    }
     else if (key == "frames-per-second") {
         config.framesPerSecond = unstringify<int>(value);
     }
+    else if (key == "background-frames-per-second") {
+        config.backgroundFramesPerSecond = unstringify<int>(value);
+    }
     else if (key == "traditional-wrapping") {
         config.traditionalWrapping = unstringify<bool>(value);
     }
+    else if (key == "tty-write-high-water") {
+        config.ttyWriteHighWater = unhumanSize(value);
+    }
+    else if (key == "tty-read-budget") {
+        config.ttyReadBudget = unhumanSize(value);
+    }
+    else if (key == "tty-reader-thread") {
+        config.ttyReaderThread = unstringify<bool>(value);
+    }
+    else if (key == "emulation-threads") {
+        config.emulationThreads = unstringify<size_t>(value);
+    }
+    else if (key == "shell-pool") {
+        config.shellPool = unstringify<size_t>(value);
+    }
+    else if (key == "io-uring") {
+        config.ioUring = unstringify<bool>(value);
+    }
+    else if (key == "low-latency-echo") {
+        config.lowLatencyEcho = unstringify<bool>(value);
+    }
+    else if (key == "trace-latency") {
+        config.traceLatency = unstringify<bool>(value);
+    }
     else if (key == "trace-tty") {
         config.traceTty = unstringify<bool>(value);
     }
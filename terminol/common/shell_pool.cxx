@@ -0,0 +1,93 @@
+// vi:noai:sw=4
+
+#include "terminol/common/shell_pool.hxx"
+#include "terminol/common/tty.hxx"
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+namespace {
+
+const uint32_t RETRY_MS = 1000;     // after a failed spawn
+
+} // namespace {anonymous}
+
+ShellPool::ShellPool(I_Selector & selector, const Config & config) :
+    _selector(selector),
+    _config(config),
+    _shells(),
+    _refillTimer(-1),
+    _refilling(false)
+{
+    // Not spawned here: terminols may yet daemonise, and the shells must
+    // be children of the process that serves the windows.
+    _refillTimer = _selector.addTimer(this, 0, false);
+    _refilling   = true;
+}
+
+ShellPool::~ShellPool() {
+    _selector.removeTimer(_refillTimer);
+
+    for (auto & shell : _shells) { discard(shell); }
+}
+
+bool ShellPool::take(int & fd, pid_t & pid) {
+    while (!_shells.empty()) {
+        auto shell = _shells.front();
+        _shells.pop_front();
+
+        refill(0);
+
+        // It may have exited while it waited.
+        int status;
+        auto rval = TEMP_FAILURE_RETRY(::waitpid(shell.pid, &status, WNOHANG));
+        ENFORCE_SYS(rval != -1, "");
+
+        if (rval == 0) {
+            fd  = shell.fd;
+            pid = shell.pid;
+            return true;
+        }
+
+        WARNING("Pooled shell exited early: " << shell.pid);
+        ENFORCE_SYS(::close(shell.fd) != -1, "");
+    }
+
+    return false;
+}
+
+void ShellPool::refill(uint32_t milliseconds) {
+    if (!_refilling) {
+        _selector.armTimer(_refillTimer, milliseconds);
+        _refilling = true;
+    }
+}
+
+void ShellPool::discard(const Shell & shell) {
+    ENFORCE_SYS(::close(shell.fd) != -1, "");
+    ::kill(shell.pid, SIGKILL);
+    ENFORCE_SYS(TEMP_FAILURE_RETRY(::waitpid(shell.pid, nullptr, 0)) == shell.pid, "");
+}
+
+// I_Selector::I_TimerHandler implementation:
+
+void ShellPool::handleTimer(int timer) throw () {
+    ASSERT(timer == _refillTimer, "");
+    _refilling = false;
+
+    if (_shells.size() >= _config.shellPool) { return; }
+
+    // One at a time so the windows we have keep being served.
+    try {
+        Shell shell;
+        shell.pid = Tty::spawn(_config, _config.initialRows, _config.initialCols,
+                               std::string(), Tty::Command(), Tty::Options(), shell.fd);
+        _shells.push_back(shell);
+        refill(0);
+    }
+    catch (const Tty::Error & error) {
+        WARNING("Failed to pool a shell: " << error.message);
+        refill(RETRY_MS);
+    }
+}
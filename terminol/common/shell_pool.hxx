@@ -0,0 +1,57 @@
+// vi:noai:sw=4
+
+#ifndef COMMON__SHELL_POOL__HXX
+#define COMMON__SHELL_POOL__HXX
+
+#include "terminol/common/config.hxx"
+#include "terminol/support/selector.hxx"
+#include "terminol/support/pattern.hxx"
+
+#include <deque>
+
+#include <sys/types.h>
+
+//
+// Shells started ahead of time on ptys of the initial size, so a new
+// window doesn't wait for the shell to start up (reading its rc files
+// and the like) before its first prompt. A taken shell is replaced a
+// shell per round of the event loop. Pooled shells are started before
+// their window exists and so don't get WINDOWID in their environment.
+// Commands aren't pooled.
+//
+
+class ShellPool :
+    protected I_Selector::I_TimerHandler,
+    protected Uncopyable
+{
+    struct Shell {
+        int   fd;       // pty master
+        pid_t pid;
+    };
+
+    I_Selector        & _selector;
+    const Config      & _config;
+    std::deque<Shell>   _shells;
+    int                 _refillTimer;
+    bool                _refilling;
+
+public:
+    ShellPool(I_Selector & selector, const Config & config);
+    virtual ~ShellPool();               // kills the shells still pooled
+
+    size_t getSize() const { return _shells.size(); }
+
+    // The caller owns the pty and child from now on, and should resize
+    // it. Returns false if the pool is empty.
+    bool take(int & fd, pid_t & pid);
+
+protected:
+    void refill(uint32_t milliseconds);
+    static void discard(const Shell & shell);
+
+    // I_Selector::I_TimerHandler implementation:
+
+    void handleTimer(int timer) throw ();
+};
+
+#endif // COMMON__SHELL_POOL__HXX
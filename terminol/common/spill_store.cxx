@@ -0,0 +1,154 @@
+// vi:noai:sw=4
+
+#include "terminol/common/spill_store.hxx"
+#include "terminol/support/debug.hxx"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+const size_t SpillStore::SEGMENT_BYTES;
+
+SpillStore::SpillStore(const std::string & dir) throw (Error) :
+    _fd(-1),
+    _fileSize(0),
+    _segments(),
+    _liveBytes(0)
+{
+    std::string path = dir + "/terminol-spill-XXXXXX";
+    std::vector<char> buf(path.begin(), path.end());
+    buf.push_back('\0');
+
+    _fd = ::mkstemp(&buf.front());
+    if (_fd == -1) {
+        throw Error("Failed to create spill file in: " + dir);
+    }
+
+    // Nobody else needs to see it, and this way it goes when we go.
+    ::unlink(&buf.front());
+    ENFORCE_SYS(::fcntl(_fd, F_SETFD, FD_CLOEXEC) != -1, "::fcntl() failed");
+}
+
+SpillStore::~SpillStore() {
+    for (auto & s : _segments) {
+        if (s.cells) {
+            ENFORCE_SYS(::munmap(s.cells, s.bytes) != -1, "");
+        }
+    }
+
+    ENFORCE_SYS(::close(_fd) != -1, "::close() failed");
+}
+
+SpillStore::Ref SpillStore::append(const std::vector<Cell> & cells) throw (Error) {
+    if (_segments.empty() ||
+        _segments.back().used + cells.size() > _segments.back().capacity)
+    {
+        addSegment(cells.size());
+    }
+
+    auto & segment = _segments.back();
+
+    Ref ref;
+    ref.segment = _segments.size() - 1;
+    ref.offset  = segment.used;
+    ref.size    = cells.size();
+
+    if (!cells.empty()) {
+        std::memcpy(segment.cells + segment.used, &cells.front(), cells.size() * sizeof(Cell));
+    }
+
+    segment.used += ref.size;
+    segment.live += ref.size;
+    _liveBytes   += ref.size * sizeof(Cell);
+
+    return ref;
+}
+
+void SpillStore::read(Ref ref, std::vector<Cell> & cells) const {
+    ASSERT(ref.segment < _segments.size(), "");
+    auto & segment = _segments[ref.segment];
+    ASSERT(segment.cells, "");
+    ASSERT(ref.offset + ref.size <= segment.used, "");
+
+    // This may fault the pages back in.
+    cells.assign(segment.cells + ref.offset, segment.cells + ref.offset + ref.size);
+}
+
+void SpillStore::release(Ref ref) {
+    ASSERT(ref.segment < _segments.size(), "");
+    auto & segment = _segments[ref.segment];
+    ASSERT(segment.live >= ref.size, "");
+
+    segment.live -= ref.size;
+    _liveBytes   -= ref.size * sizeof(Cell);
+
+    // Keep the segment we are appending to.
+    if (segment.live == 0 && ref.segment != _segments.size() - 1) {
+        dropSegment(segment);
+    }
+}
+
+void SpillStore::addSegment(size_t cells) throw (Error) {
+    auto page  = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    auto bytes = std::max(SEGMENT_BYTES, cells * sizeof(Cell));
+    bytes = (bytes + page - 1) / page * page;
+
+    if (!_segments.empty() && _segments.back().live == 0) {
+        // Nothing in the old tail is live any more.
+        dropSegment(_segments.back());
+    }
+
+    if (::ftruncate(_fd, _fileSize + bytes) == -1) {
+        throw Error("Failed to grow spill file.");
+    }
+
+    auto addr = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, _fileSize);
+    if (addr == MAP_FAILED) {
+        throw Error("Failed to map spill file.");
+    }
+
+    Segment segment;
+    segment.cells    = static_cast<Cell *>(addr);
+    segment.position = _fileSize;
+    segment.bytes    = bytes;
+    segment.capacity = bytes / sizeof(Cell);
+    segment.used     = 0;
+    segment.live     = 0;
+    _segments.push_back(segment);
+
+    _fileSize += bytes;
+}
+
+void SpillStore::dropSegment(Segment & segment) {
+    if (!segment.cells) { return; }
+
+    ENFORCE_SYS(::munmap(segment.cells, segment.bytes) != -1, "::munmap() failed");
+    segment.cells = nullptr;
+
+    // Give the space back. The file keeps its size, the hole costs nothing.
+    if (::fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                    segment.position, segment.bytes) == -1) {
+        ERROR("Failed to punch hole in spill file: " << ::strerror(errno));
+    }
+}
+
+SpillStore * openSpillStore(const std::string & dir) {
+    std::string path = dir;
+
+    if (path.empty()) {
+        auto runtimeDir = ::getenv("XDG_RUNTIME_DIR");
+        path = runtimeDir ? runtimeDir : "/tmp";
+    }
+
+    try {
+        return new SpillStore(path);
+    }
+    catch (const SpillStore::Error & ex) {
+        ERROR(ex.message);
+        return nullptr;
+    }
+}
@@ -0,0 +1,72 @@
+// vi:noai:sw=4
+
+#ifndef COMMON__SPILL_STORE__HXX
+#define COMMON__SPILL_STORE__HXX
+
+#include "terminol/common/data_types.hxx"
+#include "terminol/support/pattern.hxx"
+
+#include <vector>
+#include <string>
+
+#include <sys/types.h>
+
+//
+// Append-only storage for cold history lines in a memory-mapped file.
+// The file is unlinked as soon as it is created so it never outlives us.
+// Lines are appended to page-aligned segments; once every line in a
+// segment has been released the segment is unmapped and its pages are
+// handed back to the file system. Residency of the rest is left to the
+// page cache.
+//
+
+class SpillStore : protected Uncopyable {
+public:
+    struct Error {
+        explicit Error(const std::string & message_) : message(message_) {}
+        std::string message;
+    };
+
+    struct Ref {
+        uint32_t segment;
+        uint32_t offset;        // cells
+        uint32_t size;          // cells
+    };
+
+private:
+    struct Segment {
+        Cell   * cells;         // nullptr once released
+        off_t    position;      // bytes, in the file
+        size_t   bytes;         // mapped
+        uint32_t capacity;      // cells
+        uint32_t used;          // cells
+        uint32_t live;          // cells
+    };
+
+    static const size_t SEGMENT_BYTES = 4 * 1024 * 1024;
+
+    int                  _fd;
+    off_t                _fileSize;
+    std::vector<Segment> _segments;
+    size_t               _liveBytes;
+
+public:
+    explicit SpillStore(const std::string & dir) throw (Error);
+    ~SpillStore();
+
+    Ref    append(const std::vector<Cell> & cells) throw (Error);
+    void   read(Ref ref, std::vector<Cell> & cells) const;
+    void   release(Ref ref);
+
+    size_t getBytes() const { return _liveBytes; }
+
+protected:
+    void   addSegment(size_t cells) throw (Error);
+    void   dropSegment(Segment & segment);
+};
+
+// Create a store in dir, or $XDG_RUNTIME_DIR (then /tmp) if dir is empty.
+// Returns nullptr, after complaining, if that isn't possible.
+SpillStore * openSpillStore(const std::string & dir);
+
+#endif // COMMON__SPILL_STORE__HXX
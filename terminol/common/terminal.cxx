@@ -4,6 +4,7 @@
 #include "terminol/common/key_map.hxx"
 #include "terminol/support/conv.hxx"
 #include "terminol/support/escape.hxx"
+#include "terminol/support/time.hxx"
 
 #include <algorithm>
 #include <numeric>
@@ -72,12 +73,16 @@ Terminal::Terminal(I_Observer         & observer,
                    const Config       & config,
                    I_Selector         & selector,
                    I_Deduper          & deduper,
+                   WorkerPool         * workerPool,
+                   ShellPool          * shellPool,
                    int16_t              rows,
                    int16_t              cols,
                    const std::string  & windowId,
-                   const Tty::Command & command) throw (Tty::Error) :
+                   const Tty::Command & command,
+                   const Tty::Options & options) throw (Tty::Error) :
     _observer(observer),
     _dispatch(false),
+    _ttyFrameOwed(false),
     //
     _config(config),
     _deduper(deduper),
@@ -97,11 +102,26 @@ Terminal::Terminal(I_Observer         & observer,
     _button(Button::LEFT),
     _pointerPos(),
     _focused(true),
+    _lastViewed(monotonicMicroseconds()),
+    _lastWritten(_lastViewed),
+    _bytesParsed(0),
     _lastSeq(),
+    _pasteBacklog(),
+    _pasteOffset(0),
+    _workerPool(config.syncTty ? nullptr : workerPool),
+    _offThread(false),
+    _inFlight(false),
+    _settling(false),
+    _destroying(false),
+    _input(),
+    _parsing(),
+    _deferred(),
+    _rows(rows),
+    _cols(cols),
     //
     _utf8Machine(),
     _vtMachine(*this, _config),
-    _tty(*this, selector, config, rows, cols, windowId, command)
+    _tty(*this, selector, config, rows, cols, windowId, command, options, shellPool)
 {
     _modes.set(Mode::AUTO_WRAP);
     _modes.set(Mode::SHOW_CURSOR);
@@ -111,6 +131,12 @@ Terminal::Terminal(I_Observer         & observer,
 
 Terminal::~Terminal() {
     ASSERT(!_dispatch, "");
+
+    if (_inFlight) {
+        // Wait for the worker, but it's too late for its side effects.
+        _destroying = true;
+        _workerPool->finish(this);
+    }
 }
 
 void Terminal::resize(int16_t rows, int16_t cols) {
@@ -119,20 +145,42 @@ void Terminal::resize(int16_t rows, int16_t cols) {
 
     ASSERT(rows > 0 && cols > 0, "");
 
+    settle();
+
+    _rows = rows;
+    _cols = cols;
     _priBuffer.resizeReflow(rows, cols);
     _altBuffer.resizeClip(rows, cols);
     _tty.resize(rows, cols);
 }
 
 void Terminal::redraw() {
+    settle();
+
+    _lastViewed = monotonicMicroseconds();
+
     Region damage;
     bool   scrollbar;
     draw(Trigger::CLIENT, damage, scrollbar);
 }
 
-bool Terminal::keyPress(xkb_keysym_t keySym, ModifierSet modifiers) {
+void Terminal::present() {
+    settle();
+
+    ASSERT(!_dispatch, "");
+    _dispatch = true;
+    // Only output that was held back counts as tty output, so that
+    // showing a window doesn't scroll it to the bottom.
+    fixDamage(_ttyFrameOwed ? Trigger::TTY : Trigger::OTHER);
+    _dispatch = false;
+}
+
+bool Terminal::keyPress(xkb_keysym_t keySym, ModifierSet modifiers, bool repeat) {
+    settle();
+
     ASSERT(!_dispatch, "");
     _dispatch = true;
+    _lastViewed = monotonicMicroseconds();
 
     if (!handleKeyBinding(keySym, modifiers) && xkb::isPotent(keySym)) {
         if (_config.scrollOnTtyKeyPress && _buffer->scrollBottomHistory()) {
@@ -159,8 +207,14 @@ bool Terminal::keyPress(xkb_keysym_t keySym, ModifierSet modifiers) {
                 std::copy(seq, seq + l, input.begin());
             }
 
-            write(&input.front(), input.size());
-            if (_modes.get(Mode::ECHO)) { echo(&input.front(), input.size()); }
+            // A held key repeating into a program that isn't reading is
+            // dropped rather than queued without bound. Anything else, the
+            // first press, ^C and the like, is queued behind the backlog.
+            if (!(repeat && _tty.isCongested())) {
+                write(&input.front(), input.size());
+                if (_config.lowLatencyEcho) { _tty.expectEcho(); }
+                if (_modes.get(Mode::ECHO)) { echo(&input.front(), input.size()); }
+            }
         }
 
         _dispatch = false;
@@ -174,8 +228,11 @@ bool Terminal::keyPress(xkb_keysym_t keySym, ModifierSet modifiers) {
 
 void Terminal::buttonPress(Button button, int count, ModifierSet modifiers,
                            bool UNUSED(within), HPos hpos) {
+    settle();
+
     ASSERT(!_dispatch, "");
     _dispatch = true;
+    _lastViewed = monotonicMicroseconds();
 
     /*
     PRINT("press: " << button << ", count=" << count <<
@@ -224,6 +281,8 @@ select:
 }
 
 void Terminal::pointerMotion(ModifierSet modifiers, bool within, HPos hpos) {
+    settle();
+
     ASSERT(!_dispatch, "");
     _dispatch = true;
 
@@ -277,6 +336,8 @@ void Terminal::pointerMotion(ModifierSet modifiers, bool within, HPos hpos) {
 }
 
 void Terminal::buttonRelease(bool UNUSED(broken), ModifierSet modifiers) {
+    settle();
+
     ASSERT(!_dispatch, "");
     _dispatch = true;
 
@@ -337,8 +398,11 @@ report:
 }
 
 void Terminal::scrollWheel(ScrollDir dir, ModifierSet modifiers, bool UNUSED(within), Pos pos) {
+    settle();
+
     ASSERT(!_dispatch, "");
     _dispatch = true;
+    _lastViewed = monotonicMicroseconds();
 
     if (_modes.get(Mode::MOUSE_PRESS_RELEASE)) {
         sendMouseButton(dir == ScrollDir::UP ? 3 : 4, modifiers, pos);
@@ -367,6 +431,8 @@ void Terminal::scrollWheel(ScrollDir dir, ModifierSet modifiers, bool UNUSED(wit
 }
 
 void Terminal::paste(const uint8_t * data, size_t size) {
+    settle();
+
     ASSERT(!_dispatch, "");
     _dispatch = true;
 
@@ -374,20 +440,28 @@ void Terminal::paste(const uint8_t * data, size_t size) {
         fixDamage(Trigger::OTHER);
     }
 
+    // The paste joins the backlog and is fed to the tty as it drains.
+    const char * begin = "\x1B[200~";
+    const char * end   = "\x1B[201~";
+
     if (_modes.get(Mode::BRACKETED_PASTE)) {
-        write(reinterpret_cast<const uint8_t *>("\x1B[200~"), 6);
+        _pasteBacklog.insert(_pasteBacklog.end(), begin, begin + 6);
     }
 
-    write(data, size);
+    _pasteBacklog.insert(_pasteBacklog.end(), data, data + size);
 
     if (_modes.get(Mode::BRACKETED_PASTE)) {
-        write(reinterpret_cast<const uint8_t *>("\x1B[201~"), 6);
+        _pasteBacklog.insert(_pasteBacklog.end(), end, end + 6);
     }
 
+    pumpPaste();
+
     _dispatch = false;
 }
 
 void Terminal::clearSelection() {
+    settle();
+
     ASSERT(!_dispatch, "");
     _dispatch = true;
 
@@ -398,8 +472,11 @@ void Terminal::clearSelection() {
 }
 
 void Terminal::focusChange(bool focused) {
+    settle();
+
     ASSERT(!_dispatch, "");
     _dispatch = true;
+    _lastViewed = monotonicMicroseconds();
 
     if (_focused != focused) {
         _focused = focused;
@@ -421,12 +498,37 @@ void Terminal::focusChange(bool focused) {
     _dispatch = false;
 }
 
+size_t Terminal::getHistoryBytes() {
+    settle();
+    return _priBuffer.getHistoryBytes();
+}
+
+uint32_t Terminal::getHistoryLines() {
+    settle();
+    return _priBuffer.getHistory();
+}
+
+bool Terminal::trimHistory(size_t bytes) {
+    settle();
+
+    ASSERT(!_dispatch, "");
+    _dispatch = true;
+
+    auto trimmed = _priBuffer.trimHistory(bytes);
+    if (trimmed) { fixDamage(Trigger::OTHER); }
+
+    _dispatch = false;
+
+    return trimmed;
+}
+
 bool Terminal::hasSubprocess() const {
     return _tty.hasSubprocess();
 }
 
-int Terminal::close() {
-    return _tty.close();
+void Terminal::close() {
+    settle();
+    _tty.close();
 }
 
 bool Terminal::handleKeyBinding(xkb_keysym_t keySym, ModifierSet modifiers) {
@@ -525,7 +627,9 @@ bool Terminal::handleKeyBinding(xkb_keysym_t keySym, ModifierSet modifiers) {
 
                 std::ostringstream ost;
                 ost << "line-data=" << humanSize(bytes1) << " "
-                    << "(non-dedupe=" << humanSize(bytes2) << ")";
+                    << "(non-dedupe=" << humanSize(bytes2) << ") "
+                    << "history=" << humanSize(_priBuffer.getHistoryBytes())
+                    << "/" << _priBuffer.getHistory() << " rows";
                 _observer.terminalSetWindowTitle(ost.str());
                 return true;
             }
@@ -553,6 +657,8 @@ bool Terminal::handleKeyBinding(xkb_keysym_t keySym, ModifierSet modifiers) {
 }
 
 void Terminal::fixDamage(Trigger trigger) {
+    if (trigger == Trigger::TTY) { _ttyFrameOwed = false; }
+
     if (trigger == Trigger::TTY &&          // We're overusing this Damage now.
         _config.scrollOnTtyOutput)
     {
@@ -568,6 +674,53 @@ void Terminal::fixDamage(Trigger trigger) {
     }
 }
 
+// Draw the output parsed so far, now or when the observer calls present().
+void Terminal::ttyFrame() {
+    if (_observer.terminalAdmitFrame()) { fixDamage(Trigger::TTY); }
+    else                                { _ttyFrameOwed = true; }
+}
+
+// Bring the buffers up to date with everything read so far.
+void Terminal::settle() {
+    if (!_workerPool) { return; }
+
+    if (_inFlight) {
+        _settling = true;
+        _workerPool->finish(this);
+        _settling = false;
+    }
+
+    if (!_input.empty()) {
+        auto dispatch = _dispatch;
+        _dispatch = true;
+        processRead(&_input.front(), _input.size());
+        _input.clear();
+        _tty.holdReads(false);
+        _priBuffer.commitLines();
+        _altBuffer.commitLines();
+        ttyFrame();
+        _dispatch = dispatch;
+    }
+}
+
+void Terminal::submitInput() {
+    ASSERT(!_inFlight, "");
+
+    if (_input.empty()) { return; }
+
+    _parsing.swap(_input);
+    _input.clear();
+    _tty.holdReads(false);
+
+    _inFlight = true;
+    _workerPool->submit(this);
+}
+
+void Terminal::defer(std::function<void ()> action) {
+    if (_offThread) { _deferred.push_back(std::move(action)); }
+    else            { action(); }
+}
+
 void Terminal::draw(Trigger trigger, Region & damage, bool & scrollbar) {
     damage.clear();
 
@@ -647,7 +800,32 @@ void Terminal::draw(Trigger trigger, Region & damage, bool & scrollbar) {
 }
 
 void Terminal::write(const uint8_t * data, size_t size) {
-    _tty.write(data, size);
+    if (_offThread) {
+        std::vector<uint8_t> copy(data, data + size);
+        _deferred.push_back([this, copy] { write(&copy.front(), copy.size()); });
+    }
+    else if (_pasteBacklog.empty()) {
+        _tty.write(data, size);
+    }
+    else {
+        // Don't overtake the paste.
+        _pasteBacklog.insert(_pasteBacklog.end(), data, data + size);
+    }
+}
+
+void Terminal::pumpPaste() {
+    const size_t CHUNK = 4096;
+
+    while (_pasteOffset != _pasteBacklog.size() && !_tty.isCongested()) {
+        auto size = std::min(CHUNK, _pasteBacklog.size() - _pasteOffset);
+        _tty.write(&_pasteBacklog[_pasteOffset], size);
+        _pasteOffset += size;
+    }
+
+    if (_pasteOffset == _pasteBacklog.size()) {
+        _pasteBacklog.clear();
+        _pasteOffset = 0;
+    }
 }
 
 void Terminal::echo(const uint8_t * data, size_t size) {
@@ -723,7 +901,7 @@ void Terminal::resetAll() {
     _modes.set(Mode::AUTO_REPEAT);
     _modes.set(Mode::ALT_SENDS_ESC);
 
-    _observer.terminalResetTitleAndIcon();
+    defer([this] { _observer.terminalResetTitleAndIcon(); });
 }
 
 void Terminal::processRead(const uint8_t * data, size_t size) {
@@ -1011,11 +1189,11 @@ void Terminal::processModes(uint8_t priv, bool set, const std::vector<int32_t> &
                     _buffer->reset();
                     if (set) {
                         // resize 132 columns
-                        _observer.terminalResizeBuffer(getRows(), 132);
+                        defer([this] { _observer.terminalResizeBuffer(getRows(), 132); });
                     }
                     else {
                         // resize 80 columns
-                        _observer.terminalResizeBuffer(getRows(), 80);
+                        defer([this] { _observer.terminalResizeBuffer(getRows(), 80); });
                     }
                     break;
                 case 4: // DECSCLM - Scroll Mode - Smooth / Jump (IGNORED)
@@ -1204,7 +1382,7 @@ void Terminal::machineNormal(utf8::Seq seq, utf8::Length UNUSED(length)) throw (
 void Terminal::machineControl(uint8_t control) throw () {
     switch (control) {
         case BEL:
-            _observer.terminalBeep();
+            defer([this] { _observer.terminalBeep(); });
             break;
         case HT:
             _buffer->tabCursor(TabDir::FORWARD, 1);
@@ -1489,7 +1667,7 @@ void Terminal::machineCsi(uint8_t priv,
                         }
                         case 8: {
                             // Ps = 8   Request Version Number (place in window title)
-                            _observer.terminalSetWindowTitle("Terminol " VERSION);
+                            defer([this] { _observer.terminalSetWindowTitle("Terminol " VERSION); });
                             break;
                         }
                         case 15: {
@@ -1602,15 +1780,24 @@ void Terminal::machineOsc(const std::vector<std::string> & args) throw () {
             switch (unstringify<int>(args[0])) {
                 case 0: // Icon name and window title
                     if (args.size() > 1) {
-                        _observer.terminalSetIconName(args[1]);
-                        _observer.terminalSetWindowTitle(args[1]);
+                        auto str = args[1];
+                        defer([this, str] {
+                            _observer.terminalSetIconName(str);
+                            _observer.terminalSetWindowTitle(str);
+                        });
                     }
                     break;
                 case 1: // Icon name
-                    if (args.size() > 1) { _observer.terminalSetIconName(args[1]); }
+                    if (args.size() > 1) {
+                        auto str = args[1];
+                        defer([this, str] { _observer.terminalSetIconName(str); });
+                    }
                     break;
                 case 2: // Window title
-                    if (args.size() > 1) { _observer.terminalSetWindowTitle(args[1]); }
+                    if (args.size() > 1) {
+                        auto str = args[1];
+                        defer([this, str] { _observer.terminalSetWindowTitle(str); });
+                    }
                     break;
                 case 55:
                     NYI("Log history to file");
@@ -1619,7 +1806,7 @@ void Terminal::machineOsc(const std::vector<std::string> & args) throw () {
                     // tmux gives us this...
                     break;
                 case 666: // terminol extension (fix the damage)
-                    fixDamage(Trigger::TTY);
+                    defer([this] { fixDamage(Trigger::TTY); });
                     break;
                 default:
                     // TODO consult http://rtfm.etla.org/xterm/ctlseq.html AND man 7 urxvt.
@@ -1748,24 +1935,88 @@ void Terminal::machineSpecial(const std::vector<uint8_t> & inters,
 void Terminal::ttyData(const uint8_t * data, size_t size) throw () {
     ASSERT(!_dispatch, "");
     _dispatch = true;
-    processRead(data, size);
+    _lastWritten = monotonicMicroseconds();
+
+    if (_workerPool) {
+        _input.insert(_input.end(), data, data + size);
+        // Don't read further ahead of the worker than this.
+        if (_input.size() >= 4 * _config.ttyReadBudget) { _tty.holdReads(true); }
+    }
+    else {
+        processRead(data, size);
+        _bytesParsed += size;
+    }
+
     _dispatch = false;
 }
 
 void Terminal::ttySync() throw () {
     ASSERT(!_dispatch, "");
+
+    if (_workerPool) {
+        // Otherwise jobDone() will pick up the new input.
+        if (!_inFlight) { submitInput(); }
+        return;
+    }
+
+    _dispatch = true;
+    _priBuffer.commitLines();
+    _altBuffer.commitLines();
+    ttyFrame();
+    _dispatch = false;
+}
+
+void Terminal::ttyDrained() throw () {
+    ASSERT(!_dispatch, "");
     _dispatch = true;
-    fixDamage(Trigger::TTY);
+    pumpPaste();
     _dispatch = false;
 }
 
 void Terminal::ttyExited(int exitCode) throw () {
+    settle();
+
     ASSERT(!_dispatch, "");
     _dispatch = true;
     _observer.terminalChildExited(exitCode);
     _dispatch = false;
 }
 
+// WorkerPool::I_Job implementation:
+
+void Terminal::jobRun() throw () {
+    _offThread = true;
+    processRead(&_parsing.front(), _parsing.size());
+    _priBuffer.commitLines();
+    _altBuffer.commitLines();
+    _offThread = false;
+}
+
+void Terminal::jobDone() throw () {
+    ASSERT(_inFlight, "");
+    _inFlight = false;
+    _bytesParsed += _parsing.size();
+    _parsing.clear();
+
+    if (_destroying) {
+        _deferred.clear();
+        return;
+    }
+
+    ASSERT(!_dispatch, "");
+    _dispatch = true;
+
+    std::vector<std::function<void ()>> deferred;
+    deferred.swap(_deferred);
+    for (auto & action : deferred) { action(); }
+
+    ttyFrame();
+
+    _dispatch = false;
+
+    if (!_settling) { submitInput(); }
+}
+
 std::ostream & operator << (std::ostream & ost, Terminal::Button button) {
     switch (button) {
         case Terminal::Button::LEFT:
@@ -10,13 +10,17 @@
 #include "terminol/common/buffer.hxx"
 #include "terminol/common/deduper_interface.hxx"
 #include "terminol/support/selector.hxx"
+#include "terminol/support/worker_pool.hxx"
 #include "terminol/support/pattern.hxx"
 
+#include <functional>
+
 #include <xkbcommon/xkbcommon.h>
 
 class Terminal :
     protected VtStateMachine::I_Observer,
     protected Tty::I_Observer,
+    protected WorkerPool::I_Job,
     protected Uncopyable
 {
     static const CharSub CS_US;
@@ -36,6 +40,7 @@ public:
         virtual void terminalSetIconName(const std::string & str) throw () = 0;
         virtual void terminalBeep() throw () = 0;
         virtual void terminalResizeBuffer(int16_t rows, int16_t cols) throw () = 0;
+        virtual bool terminalAdmitFrame() throw () = 0;     // else present() later
         virtual bool terminalFixDamageBegin() throw () = 0;
         virtual void terminalDrawBg(Pos    pos,
                                     UColor color,
@@ -75,6 +80,7 @@ public:
 private:
     I_Observer          & _observer;
     bool                  _dispatch;
+    bool                  _ttyFrameOwed;    // output not yet drawn, see present()
 
     const Config        & _config;
     const I_Deduper     & _deduper;
@@ -91,9 +97,35 @@ private:
     Button                _button;
     Pos                   _pointerPos;
     bool                  _focused;
+    uint64_t              _lastViewed;      // monotonicMicroseconds()
+    uint64_t              _lastWritten;     // monotonicMicroseconds()
+    uint64_t              _bytesParsed;
 
     utf8::Seq             _lastSeq;
 
+    std::vector<uint8_t>  _pasteBacklog;    // waiting for the tty to drain
+    size_t                _pasteOffset;     // into _pasteBacklog
+
+    // With a worker pool, tty output is parsed on a worker while the
+    // main thread goes on reading into _input. Whatever the parse wants
+    // to do to the window or the tty is deferred until jobDone(). Any
+    // other way in must settle() first. Reading stays on the main thread:
+    // a read is a cheap copy next to the parse, and the Tty shares its
+    // state (write queue, held reads, the child) with key presses and the
+    // selector, which aren't thread safe.
+
+    WorkerPool          * _workerPool;      // nullptr -> parse inline
+    bool                  _offThread;       // in jobRun()
+    bool                  _inFlight;        // submitted, not yet done
+    bool                  _settling;
+    bool                  _destroying;
+    std::vector<uint8_t>  _input;           // read, not yet parsed
+    std::vector<uint8_t>  _parsing;         // owned by the worker
+    std::vector<std::function<void ()>> _deferred;
+
+    int16_t               _rows;            // safe to read during a parse
+    int16_t               _cols;
+
     //
 
     utf8::Machine         _utf8Machine;
@@ -105,24 +137,40 @@ public:
              const Config       & config,
              I_Selector         & selector,
              I_Deduper          & deduper,
+             WorkerPool         * workerPool,
+             ShellPool          * shellPool,
              int16_t              rows,
              int16_t              cols,
              const std::string  & windowId,
-             const Tty::Command & command) throw (Tty::Error);
+             const Tty::Command & command,
+             const Tty::Options & options) throw (Tty::Error);
     virtual ~Terminal();
 
     // Geometry:
 
-    int16_t getRows() const { return _buffer->getRows(); }
-    int16_t getCols() const { return _buffer->getCols(); }
+    int16_t getRows() const { return _rows; }
+    int16_t getCols() const { return _cols; }
+
+    // History:
+
+    // These settle first: a worker may be adding to the history.
+    size_t  getHistoryBytes();
+    uint32_t getHistoryLines();
+    uint64_t getLastActivity() const { return std::max(_lastViewed, _lastWritten); }
+    bool    trimHistory(size_t bytes);
+
+    // Statistics:
+
+    uint64_t getBytesParsed() const { return _bytesParsed; }
 
     // Events:
 
     void     resize(int16_t rows, int16_t cols);
 
     void     redraw();
+    void     present();
 
-    bool     keyPress(xkb_keysym_t keySym, ModifierSet modifiers);
+    bool     keyPress(xkb_keysym_t keySym, ModifierSet modifiers, bool repeat);
     void     buttonPress(Button button, int count, ModifierSet modifiers,
                          bool within, HPos hpos);
     void     pointerMotion(ModifierSet modifiers, bool within, HPos hpos);
@@ -136,7 +184,7 @@ public:
     void     focusChange(bool focused);
 
     bool     hasSubprocess() const;
-    int      close();
+    void     close();           // terminalChildExited() follows
 
 protected:
     enum class Trigger { TTY, FOCUS, CLIENT, OTHER };
@@ -144,10 +192,16 @@ protected:
     bool     handleKeyBinding(xkb_keysym_t keySym, ModifierSet modifiers);
 
     void     fixDamage(Trigger trigger);
+    void     ttyFrame();
+
+    void     settle();
+    void     submitInput();
+    void     defer(std::function<void ()> action);
 
     void     draw(Trigger trigger, Region & damage, bool & scrollbar);
 
     void     write(const uint8_t * data, size_t size);
+    void     pumpPaste();
     void     echo(const uint8_t * data, size_t size);
 
     void     sendMouseButton(int num, ModifierSet modifiers, Pos pos);
@@ -178,7 +232,13 @@ protected:
 
     void     ttyData(const uint8_t * data, size_t size) throw ();
     void     ttySync() throw ();
+    void     ttyDrained() throw ();
     void     ttyExited(int exitCode) throw ();
+
+    // WorkerPool::I_Job implementation:
+
+    void     jobRun() throw ();
+    void     jobDone() throw ();
 };
 
 std::ostream & operator << (std::ostream & ost, Terminal::Button button);
@@ -0,0 +1,315 @@
+// vi:noai:sw=4
+
+#include "terminol/common/buffer.hxx"
+#include "terminol/common/deduper.hxx"
+#include "terminol/common/config.hxx"
+#include "terminol/support/debug.hxx"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Checks that selection damage and the run-merging draw dispatch match
+// the obvious cell at a time definitions, on random buffers.
+
+namespace {
+
+class TestBuffer : public Buffer {
+public:
+    TestBuffer(const Config & config, I_Deduper & deduper,
+               int16_t rows, int16_t cols, uint32_t historyLimit, const CharSub * cs) :
+        Buffer(config, deduper, rows, cols, historyLimit, cs, cs) {}
+
+    using Buffer::APos;
+    using Buffer::isCellSelected;
+    using Buffer::selectedSpan;
+    using Buffer::normaliseSelection;
+    using Buffer::getRowCells;
+    using Buffer::getWrap;
+
+    // Whether each cell of the viewport is selected, row by row.
+    std::vector<bool> selectedCells() const {
+        std::vector<bool> cells(getRows() * getCols(), false);
+        APos begin, end;
+        if (!normaliseSelection(begin, end)) { return cells; }
+
+        for (int16_t r = 0; r != getRows(); ++r) {
+            auto row  = static_cast<int32_t>(r) - static_cast<int32_t>(getScrollOffset());
+            auto wrap = getWrap(r);
+            for (int16_t c = 0; c != getCols(); ++c) {
+                cells[r * getCols() + c] = isCellSelected(APos(row, c), begin, end, wrap);
+            }
+        }
+
+        return cells;
+    }
+};
+
+int pick(int n) { return std::rand() % n; }
+
+HPos randomHPos(const Buffer & buffer) {
+    return HPos(pick(buffer.getRows()), pick(buffer.getCols()),
+                pick(2) ? Hand::LEFT : Hand::RIGHT);
+}
+
+void changeSelection(Buffer & buffer) {
+    switch (pick(6)) {
+        case 0:
+            buffer.markSelection(randomHPos(buffer));
+            break;
+        case 1:
+            buffer.clearSelection();
+            break;
+        default:
+            buffer.delimitSelection(randomHPos(buffer), pick(4) == 0);
+            break;
+    }
+}
+
+// Lines of random length (so some wrap) and style, some not ASCII.
+void fill(Buffer & buffer, int lines) {
+    for (int l = 0; l != lines; ++l) {
+        auto length = pick(3 * buffer.getCols());
+
+        for (int i = 0; i != length; ++i) {
+            if (pick(5) == 0) {
+                buffer.resetStyle();
+                if (pick(2) == 0) { buffer.setAttr(Attr::INVERSE); }
+                if (pick(3) == 0) { buffer.setAttr(Attr::BOLD); }
+                if (pick(2) == 0) { buffer.setFg(UColor::indexed(pick(4))); }
+                if (pick(2) == 0) { buffer.setBg(UColor::indexed(pick(4))); }
+            }
+
+            if (pick(8) == 0) { buffer.write(utf8::Seq(0xC3, 0xA9), true, false); }
+            else              { buffer.write(utf8::Seq('a' + pick(26)), true, false); }
+        }
+
+        buffer.forwardIndex(true);
+    }
+}
+
+// The span of a row against isCellSelected(), over rows in and around
+// the selection and wraps either side of its columns.
+void testSelectedSpan() {
+    Config     config;
+    Deduper    deduper;
+    CharSub    cs;
+    TestBuffer buffer(config, deduper, 12, 20, 100, &cs);
+    auto       cols = buffer.getCols();
+
+    for (int n = 0; n != 200000; ++n) {
+        TestBuffer::APos begin(pick(6) - 3, pick(cols + 1));
+        TestBuffer::APos end(pick(6) - 3, pick(cols + 1));
+        if (end.row < begin.row || (end.row == begin.row && end.col < begin.col)) {
+            std::swap(begin, end);
+        }
+
+        int32_t row  = pick(8) - 4;
+        int16_t wrap = pick(cols + 3);
+
+        int16_t colBegin, colEnd;
+        buffer.selectedSpan(row, begin, end, wrap, colBegin, colEnd);
+
+        for (int16_t c = 0; c != cols; ++c) {
+            auto expected = TestBuffer::isCellSelected(TestBuffer::APos(row, c), begin, end, wrap);
+            auto actual   = c >= colBegin && c < colEnd;
+            ENFORCE(actual == expected,
+                    "Row " << row << " col " << c << " wrap " << wrap <<
+                    " selection " << begin.row << ',' << begin.col <<
+                    " - " << end.row << ',' << end.col <<
+                    " span " << colBegin << '-' << colEnd);
+        }
+    }
+}
+
+// The cells dispatchBg() covers, which are the damaged ones.
+std::vector<bool> damagedCells(const Buffer & buffer) {
+    std::vector<bool> cells(buffer.getRows() * buffer.getCols(), false);
+
+    buffer.dispatchBg(false, [&](Pos pos, UColor, size_t count) {
+        for (size_t i = 0; i != count; ++i) {
+            cells[pos.row * buffer.getCols() + pos.col + i] = true;
+        }
+    });
+
+    return cells;
+}
+
+// A selection change must damage every cell whose selectedness changed.
+void testSelectionDamage() {
+    Config     config;
+    Deduper    deduper;
+    CharSub    cs;
+    TestBuffer buffer(config, deduper, 12, 20, 100, &cs);
+
+    fill(buffer, 300);
+
+    for (int offset = 0; offset != 4; ++offset) {
+        buffer.scrollUpHistory(offset);
+
+        for (int n = 0; n != 20000; ++n) {
+            auto before = buffer.selectedCells();
+            buffer.resetDamage();
+            changeSelection(buffer);
+            auto after   = buffer.selectedCells();
+            auto damaged = damagedCells(buffer);
+
+            for (size_t i = 0; i != before.size(); ++i) {
+                ENFORCE(before[i] == after[i] || damaged[i],
+                        "Undamaged change at row " << i / buffer.getCols() <<
+                        " col " << i % buffer.getCols());
+            }
+        }
+    }
+}
+
+// What a cell should be drawn as.
+struct Drawn {
+    UColor      bg;
+    UColor      fg;
+    AttrSet     attrs;
+    std::string text;
+};
+
+Drawn expectedCell(const Config & config, const TestBuffer & buffer,
+                   bool selValid, TestBuffer::APos selBegin, TestBuffer::APos selEnd,
+                   bool reverse, int16_t r, int16_t c) {
+    uint32_t offset;
+    int16_t  wrap;
+    auto &   cells = buffer.getRowCells(r, offset, wrap);
+
+    auto   row      = static_cast<int32_t>(r) - static_cast<int32_t>(buffer.getScrollOffset());
+    auto   selected = selValid && TestBuffer::isCellSelected(TestBuffer::APos(row, c),
+                                                              selBegin, selEnd, wrap);
+    auto   blank    = Cell::blank();
+    auto & cell     = c + offset < cells.size() ? cells[c + offset] : blank;
+    auto & style    = cell.style;
+    auto   swap     = XOR(reverse, style.attrs.get(Attr::INVERSE));
+
+    auto bg = swap ? style.fg : style.bg;
+    auto fg = swap ? style.bg : style.fg;
+
+    if (selected) {
+        if      (config.customSelectBgColor)  { bg = UColor::stock(UColor::Name::SELECT_BG); }
+        else if (!config.customSelectFgColor) { bg = !swap ? style.fg : style.bg; }
+
+        if      (config.customSelectFgColor)  { fg = UColor::stock(UColor::Name::SELECT_FG); }
+        else if (!config.customSelectBgColor) { fg = !swap ? style.bg : style.fg; }
+    }
+
+    std::string text(reinterpret_cast<const char *>(cell.seq.bytes),
+                     utf8::leadLength(cell.seq.lead()));
+    Drawn drawn = { bg, fg, style.attrs, text };
+
+    return drawn;
+}
+
+// Dispatch the damage and check it against expectedCell(): the runs
+// must cover each damaged cell once, with its colours, attributes and
+// text, and be as long as they can be.
+void checkDispatch(const Config & config, const TestBuffer & buffer, bool reverse) {
+    auto rows = buffer.getRows();
+    auto cols = buffer.getCols();
+
+    TestBuffer::APos selBegin, selEnd;
+    auto selValid = buffer.normaliseSelection(selBegin, selEnd);
+
+    auto expected = [&](int16_t r, int16_t c) {
+        return expectedCell(config, buffer, selValid, selBegin, selEnd, reverse, r, c);
+    };
+
+    std::vector<int> bgCover(rows * cols, 0);
+    Pos              lastBg(-1, 0);
+    auto             lastBgColor = UColor::stock(UColor::Name::TEXT_BG);
+
+    buffer.dispatchBg(reverse, [&](Pos pos, UColor color, size_t count) {
+        ENFORCE(count != 0, "");
+        ENFORCE(!(lastBg == pos && lastBgColor == color), "Unmerged bg run at " << pos);
+
+        for (size_t i = 0; i != count; ++i) {
+            auto c = static_cast<int16_t>(pos.col + i);
+            ++bgCover[pos.row * cols + c];
+            ENFORCE(expected(pos.row, c).bg == color, "Bg at " << Pos(pos.row, c));
+        }
+
+        lastBg      = Pos(pos.row, pos.col + count);
+        lastBgColor = color;
+    });
+
+    std::vector<int> fgCover(rows * cols, 0);
+    Pos              lastFg(-1, 0);
+    auto             lastFgColor = UColor::stock(UColor::Name::TEXT_FG);
+    AttrSet          lastAttrs;
+
+    buffer.dispatchFg(reverse, [&](Pos pos, UColor color, AttrSet attrs,
+                                   const uint8_t * str, size_t size, size_t count) {
+        ENFORCE(count != 0, "");
+        ENFORCE(str[size] == NUL, "");
+        ENFORCE(!(lastFg == pos && lastFgColor == color && lastAttrs == attrs),
+                "Unmerged fg run at " << pos);
+
+        std::string text;
+        for (size_t i = 0; i != count; ++i) {
+            auto c    = static_cast<int16_t>(pos.col + i);
+            auto cell = expected(pos.row, c);
+            ++fgCover[pos.row * cols + c];
+            ENFORCE(cell.fg == color && cell.attrs == attrs, "Fg at " << Pos(pos.row, c));
+            text += cell.text;
+        }
+        ENFORCE(text == std::string(reinterpret_cast<const char *>(str), size),
+                "Text at " << pos);
+
+        lastFg      = Pos(pos.row, pos.col + count);
+        lastFgColor = color;
+        lastAttrs   = attrs;
+    });
+
+    // Both cover the damage, a single span per row.
+    for (int16_t r = 0; r != rows; ++r) {
+        int spans = 0;
+        for (int16_t c = 0; c != cols; ++c) {
+            auto i = r * cols + c;
+            ENFORCE(bgCover[i] <= 1 && bgCover[i] == fgCover[i], "Cover at " << Pos(r, c));
+            if (bgCover[i] == 1 && (c == 0 || bgCover[i - 1] == 0)) { ++spans; }
+        }
+        ENFORCE(spans <= 1, "Damage split on row " << r);
+    }
+}
+
+void testDispatch() {
+    for (unsigned seed = 1; seed != 3000; ++seed) {
+        std::srand(seed);
+
+        Config config;
+        config.customSelectBgColor = pick(2) == 0;
+        config.customSelectFgColor = pick(2) == 0;
+
+        Deduper    deduper;
+        CharSub    cs;
+        TestBuffer buffer(config, deduper, 8, 16, 50, &cs);
+
+        fill(buffer, 30);
+
+        for (int n = 0; n != 40; ++n) {
+            if (pick(4) == 0) { buffer.scrollUpHistory(pick(4)); }
+            if (pick(4) == 0) { buffer.scrollDownHistory(pick(4)); }
+            changeSelection(buffer);
+
+            // Mostly just what the selection change damaged.
+            if (pick(3) == 0) { buffer.damageViewport(false); }
+
+            checkDispatch(config, buffer, pick(2) == 0);
+            buffer.resetDamage();
+        }
+    }
+}
+
+} // namespace {anonymous}
+
+int main() {
+    testSelectedSpan();
+    testSelectionDamage();
+    testDispatch();
+
+    return 0;
+}
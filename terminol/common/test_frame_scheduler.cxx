@@ -0,0 +1,111 @@
+// vi:noai:sw=4
+
+#include "terminol/common/frame_scheduler.hxx"
+#include "terminol/support/debug.hxx"
+
+#include <unistd.h>
+
+namespace {
+
+// Records how the scheduler arms its timer, without any fds.
+class Selector : public I_Selector {
+public:
+    uint32_t armed = 0;
+    int      arms  = 0;
+
+    virtual ~Selector() {}
+
+    void addReadable(int, I_ReadHandler *, bool) {}
+    void removeReadable(int) {}
+    void addWriteable(int, I_WriteHandler *) {}
+    void removeWriteable(int) {}
+
+    int addTimer(I_TimerHandler *, uint32_t milliseconds, bool) {
+        armTimer(1, milliseconds);
+        return 1;
+    }
+
+    void armTimer(int, uint32_t milliseconds) {
+        armed = milliseconds;
+        ++arms;
+    }
+
+    void removeTimer(int) {}
+};
+
+class Scheduler : public FrameScheduler {
+public:
+    Scheduler(I_Selector & selector, int fps, int backgroundFps) :
+        FrameScheduler(selector, fps, backgroundFps) {}
+
+    void tick() { handleTimer(1); }
+};
+
+class Client : public FrameScheduler::I_Client {
+public:
+    int      frames = 0;
+    unsigned stall  = 0;        // microseconds each frame takes
+
+    virtual ~Client() {}
+
+    void frameDue() throw () {
+        ++frames;
+        ::usleep(stall);
+    }
+};
+
+void testOverdueBackground() {
+    // 20ms foreground and 100ms background intervals.
+    Selector  selector;
+    Scheduler scheduler(selector, 50, 10);
+    Client    slow, other;
+
+    ENFORCE(!scheduler.admit(&slow, false, true), "");
+    ENFORCE(selector.armed > 90 && selector.armed <= 100, "Armed " << selector.armed);
+
+    ::usleep(50000);
+    ENFORCE(!scheduler.admit(&other, false, true), "");
+
+    // The first is due, the other not for another ~50ms. Drawing the
+    // first takes long enough to leave the other overdue.
+    ::usleep(55000);
+    slow.stall = 120000;
+    scheduler.tick();
+    ENFORCE(slow.frames == 1 && other.frames == 0, "");
+
+    // Re-armed to fire at once, not wrapped around to weeks away.
+    ENFORCE(selector.armed <= 20, "Armed " << selector.armed);
+
+    scheduler.tick();
+    ENFORCE(other.frames == 1, "");
+}
+
+void testForeground() {
+    Selector  selector;
+    Scheduler scheduler(selector, 50, 10);
+    Client    client;
+
+    ENFORCE(scheduler.admit(&client, true), "Urgent must draw now");
+    ENFORCE(selector.arms == 0, "");
+
+    ENFORCE(!scheduler.admit(&client, false), "");
+    ENFORCE(selector.arms == 1 && selector.armed <= 20, "Armed " << selector.armed);
+
+    // Already armed for sooner.
+    ENFORCE(!scheduler.admit(&client, false, true), "");
+    ENFORCE(selector.arms == 1, "");
+
+    scheduler.tick();
+    ENFORCE(client.frames == 1, "");
+
+    scheduler.remove(&client);
+}
+
+} // namespace {anonymous}
+
+int main() {
+    testForeground();
+    testOverdueBackground();
+
+    return 0;
+}
@@ -1,12 +1,15 @@
 // vi:noai:sw=4
 
 #include "terminol/common/tty.hxx"
+#include "terminol/common/shell_pool.hxx"
 #include "terminol/support/time.hxx"
 
 #include <unistd.h>
 #include <pty.h>
 #include <pwd.h>
+#include <spawn.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/fcntl.h>
@@ -15,6 +18,33 @@
 
 namespace {
 
+// After SIGCONT and SIGPIPE, one of these every ESCALATION_MS until the
+// child is reaped.
+const struct {
+    int          signal;
+    const char * name;
+} ESCALATION[] = {
+    { SIGINT,  "SIGINT"  },
+    { SIGTERM, "SIGTERM" },
+    { SIGQUIT, "SIGQUIT" },
+    { SIGKILL, "SIGKILL" }
+};
+
+const uint32_t ESCALATION_MS = 100;
+const uint32_t REAP_POLL_MS  = 10;      // without pidfd
+
+int pidfdOpen(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+const size_t TTY_READER_SLOTS      = 16;
+const size_t TTY_READER_SLOT_BYTES = 64 * 1024;
+
 // TODO consolidate this function
 std::string nthToken(const std::string & str, size_t n) throw (ParseError) {
     size_t i = 0;
@@ -42,21 +72,50 @@ Tty::Tty(I_Observer        & observer,
          uint16_t            rows,
          uint16_t            cols,
          const std::string & windowId,
-         const Command     & command) throw (Error) :
+         const Command     & command,
+         const Options     & options,
+         ShellPool         * shellPool) throw (Error) :
     _observer(observer),
     _selector(selector),
     _config(config),
     _pid(0),
     _fd(-1),
-    _dumpWrites(false)
+    _dumpWrites(false),
+    _writeBuffer(),
+    _echoExpected(false),
+    _reader(nullptr),
+    _readsHeld(false),
+    _pidFd(-1),
+    _reapTimer(-1),
+    _escalationTimer(-1),
+    _escalation(0)
 {
-    openPty(rows, cols, windowId, command);
+    int master;
+
+    // Pooled shells were started without knowing the options.
+    auto pooled = command.empty() && options.cwd.empty() && options.env.empty();
+
+    if (shellPool && pooled && shellPool->take(master, _pid)) {
+        attach(master);
+        resize(rows, cols);
+    }
+    else {
+        openPty(rows, cols, windowId, command, options);
+    }
 }
 
 Tty::~Tty() {
     if (_fd != -1) {
         close();
     }
+
+    stopReap();
+
+    if (_pid != 0) {
+        // Nobody waited for it, and there's no time for the escalation.
+        ::kill(_pid, SIGKILL);
+        waitReap();
+    }
 }
 
 void Tty::resize(uint16_t rows, uint16_t cols) {
@@ -66,40 +125,36 @@ void Tty::resize(uint16_t rows, uint16_t cols) {
 }
 
 void Tty::write(const uint8_t * data, size_t size) {
-    if (_dumpWrites) {
+    // Closed: a late reply to output that was parsed after the child went.
+    if (_dumpWrites || _fd == -1) {
         return;
     }
 
     ASSERT(_fd != -1, "");
     ASSERT(size != 0, "");
 
-    while (size != 0) {
-        auto rval =
-            TEMP_FAILURE_RETRY(::write(_fd, static_cast<const void *>(data), size));
+    // Only go straight to the fd if nothing is queued ahead of us.
+    if (_writeBuffer.empty()) {
+        auto rval = writeSome(data, size);
+        data += rval;
+        size -= rval;
 
-        if (rval == -1) {
-            switch (errno) {
-                case EAGAIN:
-                    WARNING("Dropping: " << size << " bytes");
-                    goto done;
-                case EIO:
-                    _dumpWrites = true;
-                    goto done;
-                default:
-                    FATAL("Unexpected error: " << errno << " " << ::strerror(errno));
-            }
-        }
-        else if (rval == 0) {
-            FATAL("Zero length write.");
-        }
-        else {
-            data += rval;
-            size -= rval;
-        }
+        if (size == 0 || _dumpWrites) { return; }
+
+        _selector.addWriteable(_fd, this);
     }
 
-done:                   // FIXME write a utility function for read()/write()
-    ;
+    _writeBuffer.insert(_writeBuffer.end(), data, data + size);
+}
+
+void Tty::holdReads(bool hold) {
+    if (_readsHeld == hold || _fd == -1) { return; }
+    _readsHeld = hold;
+
+    auto fd = _reader ? _reader->getFd() : _fd;
+
+    if (hold) { _selector.removeReadable(fd); }
+    else      { _selector.addReadable(fd, this); }
 }
 
 bool Tty::hasSubprocess() const {
@@ -119,47 +174,75 @@ bool Tty::hasSubprocess() const {
     }
 }
 
-int Tty::close() {
-    ASSERT(_fd != -1, "");
+void Tty::close() {
+    if (_fd == -1) { return; }          // already on its way out
 
-    _selector.removeReadable(_fd);
+    if (!_readsHeld) {
+        _selector.removeReadable(_reader ? _reader->getFd() : _fd);
+    }
+
+    if (_reader) {
+        delete _reader;         // stops the thread before the fd goes
+        _reader = nullptr;
+    }
+
+    if (!_writeBuffer.empty()) {
+        _selector.removeWriteable(_fd);
+        _writeBuffer.clear();
+    }
 
     ENFORCE_SYS(::close(_fd) != -1, "::close() failed");
     _fd = -1;
 
-    int exitCode;
-
-    // Maybe the child has already died.
-    if (pollReap(0, exitCode)) { return exitCode; }
+    // The rest happens from the selector: the child is given a chance to
+    // exit nicely, then less so. Either way ttyExited() follows.
+    startReap();
 
     ::kill(_pid, SIGCONT);
     ::kill(_pid, SIGPIPE);
-
-    // Give the child a chance to exit nicely.
-    if (pollReap(100, exitCode)) { return exitCode; }
-    PRINT("Sending SIGINT.");
-    ::kill(_pid, SIGINT);
-    if (pollReap(100, exitCode)) { return exitCode; }
-    PRINT("Sending SIGTERM.");
-    ::kill(_pid, SIGTERM);
-    if (pollReap(100, exitCode)) { return exitCode; }
-    PRINT("Sending SIGQUIT.");
-    ::kill(_pid, SIGQUIT);
-    if (pollReap(100, exitCode)) { return exitCode; }
-    PRINT("Sending SIGKILL.");
-
-    // Too slow - knock it on the head.
-    ::kill(_pid, SIGKILL);
-    return waitReap();
 }
 
 void Tty::openPty(uint16_t            rows,
                   uint16_t            cols,
                   const std::string & windowId,
-                  const Command     & command) throw (Error) {
+                  const Command     & command,
+                  const Options     & options) throw (Error) {
+    ASSERT(_fd == -1, "");
+
+    int master;
+    _pid = spawn(_config, rows, cols, windowId, command, options, master);
+    attach(master);
+}
+
+void Tty::attach(int master) {
     ASSERT(_fd == -1, "");
 
-    int master, slave;
+    // Set non-blocking.
+    int flags;
+    ENFORCE_SYS((flags = ::fcntl(master, F_GETFL)) != -1, "");
+    flags |= O_NONBLOCK;
+    ENFORCE_SYS(::fcntl(master, F_SETFL, flags) != -1, "");
+
+    // Stash the master descriptor.
+    _fd  = master;
+
+    if (_config.ttyReaderThread && !_config.syncTty) {
+        _reader = new TtyReader(_fd, TTY_READER_SLOTS, TTY_READER_SLOT_BYTES);
+        _selector.addReadable(_reader->getFd(), this);
+    }
+    else {
+        _selector.addReadable(_fd, this);
+    }
+}
+
+pid_t Tty::spawn(const Config      & config,
+                 uint16_t            rows,
+                 uint16_t            cols,
+                 const std::string & windowId,
+                 const Command     & command,
+                 const Options     & options,
+                 int               & master) throw (Error) {
+    int slave;
     struct winsize winsize = { rows, cols, 0, 0 };
 
     if (::openpty(&master, &slave, nullptr, nullptr, &winsize) == -1) {
@@ -168,86 +251,89 @@ void Tty::openPty(uint16_t            rows,
 
     auto guard = scopeGuard([&] { ::close(master); ::close(slave); });
 
-    _pid = ::fork();
-
-    if (_pid == -1) {
-        throw Error("fork() failed.");
-    }
+    auto pid = spawnShell(config, master, slave, windowId, command, options);
 
     guard.dismiss();
 
-    if (_pid != 0) {
-        // Parent code-path.
+    ENFORCE_SYS(::close(slave) != -1, "");
 
-        ENFORCE_SYS(::close(slave) != -1, "");
-
-        // Set non-blocking.
-        int flags;
-        ENFORCE_SYS((flags = ::fcntl(master, F_GETFL)) != -1, "");
-        flags |= O_NONBLOCK;
-        ENFORCE_SYS(::fcntl(master, F_SETFL, flags) != -1, "");
-
-        // Stash the master descriptor.
-        _fd  = master;
+    return pid;
+}
 
-        _selector.addReadable(_fd, this);
-    }
-    else {
-        // Child code-path.
-
-        // Create a new process group.
-        ENFORCE_SYS(::setsid() != -1, "");
-        // Hook stdin/out/err up to the PTY.
-#if 0
-        ENFORCE_SYS(::dup2(slave, STDIN_FILENO)  != -1, "");
-        ENFORCE_SYS(::dup2(slave, STDOUT_FILENO) != -1, "");
-        ENFORCE_SYS(::dup2(slave, STDERR_FILENO) != -1, "");
-#else
-        ENFORCE_SYS(::close(STDIN_FILENO) != -1, "");
-        ENFORCE_SYS(::fcntl(slave, F_DUPFD, STDIN_FILENO) != -1, "");
-        ENFORCE_SYS(::close(STDOUT_FILENO) != -1, "");
-        ENFORCE_SYS(::fcntl(slave, F_DUPFD, STDOUT_FILENO) != -1, "");
-        ENFORCE_SYS(::close(STDERR_FILENO) != -1, "");
-        ENFORCE_SYS(::fcntl(slave, F_DUPFD, STDERR_FILENO) != -1, "");
-#endif
-        ENFORCE_SYS(::ioctl(slave, TIOCSCTTY, nullptr) != -1, "");
-        ENFORCE_SYS(::close(slave) != -1, "");
-        ENFORCE_SYS(::close(master) != -1, "");
-        execShell(windowId, command);
+// posix_spawn() rather than fork(): glibc shares the address space until
+// the exec, so the cost doesn't grow with our scroll-back. That means no
+// code of ours runs in the child. The environment is built here, and the
+// child's new session gets the pty as its controlling terminal by
+// opening the slave by name.
+pid_t Tty::spawnShell(const Config      & config,
+                      int                 master,
+                      int                 slave,
+                      const std::string & windowId,
+                      const Command     & command,
+                      const Options     & options) throw (Error) {
+    char slaveName[64];
+    ENFORCE(::ptsname_r(master, slaveName, sizeof slaveName) == 0, "ptsname_r() failed.");
+
+    //
+    // Environment.
+    //
+
+    std::vector<std::string> env;
+
+    for (auto e = environ; *e; ++e) {
+        std::string str(*e);
+        auto name = str.substr(0, str.find('='));
+        if (name != "COLUMNS" && name != "LINES" && name != "TERMCAP") {
+            env.push_back(str);
+        }
     }
-}
 
-void Tty::execShell(const std::string & windowId,
-                    const Command     & command) {
-    ::unsetenv("COLUMNS");
-    ::unsetenv("LINES");
-    ::unsetenv("TERMCAP");
+    auto setEnv = [&](const std::string & name, const std::string & value, bool overwrite) {
+        auto prefix = name + '=';
+        for (auto & e : env) {
+            if (e.compare(0, prefix.size(), prefix) == 0) {
+                if (overwrite) { e = prefix + value; }
+                return;
+            }
+        }
+        env.push_back(prefix + value);
+    };
 
     auto passwd = static_cast<const struct passwd *>(::getpwuid(::getuid()));
     if (passwd) {
-        ::setenv("LOGNAME", passwd->pw_name,  1);
-        ::setenv("USER",    passwd->pw_name,  1);
-        ::setenv("SHELL",   passwd->pw_shell, 0);
-        ::setenv("HOME",    passwd->pw_dir,   0);
+        setEnv("LOGNAME", passwd->pw_name,  true);
+        setEnv("USER",    passwd->pw_name,  true);
+        setEnv("SHELL",   passwd->pw_shell, false);
+        setEnv("HOME",    passwd->pw_dir,   false);
     }
 
-    ::setenv("WINDOWID", windowId.c_str(), 1);
-    ::setenv("TERM", _config.termName.c_str(), 1);
+    // Pooled shells are spawned before their window exists.
+    if (!windowId.empty()) { setEnv("WINDOWID", windowId, true); }
+    setEnv("TERM", config.termName, true);
+
+    for (auto & e : options.env) {
+        auto i = e.find('=');
+        if (i != std::string::npos) { setEnv(e.substr(0, i), e.substr(i + 1), true); }
+    }
 
-    ::signal(SIGCHLD, SIG_DFL);
-    ::signal(SIGHUP,  SIG_DFL);
-    ::signal(SIGINT,  SIG_DFL);
-    ::signal(SIGQUIT, SIG_DFL);
-    ::signal(SIGTERM, SIG_DFL);
-    ::signal(SIGALRM, SIG_DFL);
+    std::vector<const char *> envp;
+    for (auto & e : env) { envp.push_back(e.c_str()); }
+    envp.push_back(nullptr);
+
+    //
+    // Arguments.
+    //
 
     std::vector<const char *> args;
 
     if (command.empty()) {
-        auto shell = static_cast<const char *>(::getenv("SHELL"));
+        const char * shell = nullptr;
+        for (auto & e : env) {
+            if (e.compare(0, 6, "SHELL=") == 0) { shell = e.c_str() + 6; }
+        }
         if (!shell) {
-            WARNING("Could not determine shell, falling back to: " << shell);
             shell = "/bin/sh";
+            WARNING("Could not determine shell, falling back to: " << shell);
         }
         args.push_back(shell);
         args.push_back("-i");
@@ -260,36 +346,134 @@ void Tty::execShell(const std::string & windowId,
 
     args.push_back(nullptr);
 
-    ::execvp(args[0], const_cast<char * const *>(&args.front()));
+    //
+    // Session, signals and descriptors.
+    //
+
+    posix_spawnattr_t attr;
+    ENFORCE(::posix_spawnattr_init(&attr) == 0, "");
+    auto attrGuard = scopeGuard([&] { ::posix_spawnattr_destroy(&attr); });
+
+    sigset_t defaults, mask;
+    ::sigemptyset(&defaults);
+    for (auto signal : { SIGCHLD, SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGALRM }) {
+        ::sigaddset(&defaults, signal);
+    }
+    ::sigemptyset(&mask);
+
+    ENFORCE(::posix_spawnattr_setsigdefault(&attr, &defaults) == 0, "");
+    ENFORCE(::posix_spawnattr_setsigmask(&attr, &mask) == 0, "");
+    ENFORCE(::posix_spawnattr_setflags(&attr,
+                                       POSIX_SPAWN_SETSID |
+                                       POSIX_SPAWN_SETSIGDEF |
+                                       POSIX_SPAWN_SETSIGMASK) == 0, "");
+
+    posix_spawn_file_actions_t actions;
+    ENFORCE(::posix_spawn_file_actions_init(&actions) == 0, "");
+    auto actionsGuard = scopeGuard([&] { ::posix_spawn_file_actions_destroy(&actions); });
+
+    // Opened after setsid(), so it becomes the controlling terminal.
+    ENFORCE(::posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, slaveName, O_RDWR, 0) == 0, "");
+    ENFORCE(::posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDOUT_FILENO) == 0, "");
+    ENFORCE(::posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDERR_FILENO) == 0, "");
+    ENFORCE(::posix_spawn_file_actions_addclose(&actions, master) == 0, "");
+    ENFORCE(::posix_spawn_file_actions_addclose(&actions, slave) == 0, "");
+
+    if (!options.cwd.empty()) {
+        ENFORCE(::posix_spawn_file_actions_addchdir_np(&actions, options.cwd.c_str()) == 0, "");
+    }
 
-    // If we are here then the exec call failed.
-    std::exit(127); // Same as ::system() for failed commands.
+    pid_t pid;
+    auto  rval = ::posix_spawnp(&pid, args[0], &actions, &attr,
+                                const_cast<char * const *>(&args.front()),
+                                const_cast<char * const *>(&envp.front()));
+
+    if (rval != 0) {
+        throw Error(std::string("Failed to spawn ") + args[0] + ": " + ::strerror(rval));
+    }
+
+    return pid;
 }
 
-bool Tty::pollReap(int msec, int & exitCode) {
-    ASSERT(_pid != 0, "");
-    ASSERT(msec >= 0, "");
-
-    for (;;) {
-        int  stat;
-        auto pid = TEMP_FAILURE_RETRY(::waitpid(_pid, &stat, WNOHANG));
-        ENFORCE_SYS(pid != -1, "::waitpid() failed.");
-        if (pid != 0) {
-            ENFORCE(pid == _pid, "pid mismatch.");
-            _pid = 0;
-            exitCode = WIFEXITED(stat) ? WEXITSTATUS(stat) : EXIT_FAILURE;
-            return true;
-        }
+size_t Tty::writeSome(const uint8_t * data, size_t size) {
+    size_t total = 0;
 
-        if (msec == 0) {
-            break;
+    while (size != 0) {
+        auto rval =
+            TEMP_FAILURE_RETRY(::write(_fd, static_cast<const void *>(data), size));
+
+        if (rval == -1) {
+            switch (errno) {
+                case EAGAIN:
+                    return total;
+                case EIO:
+                    _dumpWrites = true;
+                    return total;
+                default:
+                    FATAL("Unexpected error: " << errno << " " << ::strerror(errno));
+            }
+        }
+        else if (rval == 0) {
+            FATAL("Zero length write.");
+        }
+        else {
+            data  += rval;
+            size  -= rval;
+            total += rval;
         }
+    }
+
+    return total;
+}
+
+void Tty::startReap() {
+    ASSERT(_pid != 0, "");
 
-        --msec;
-        ::usleep(1000);     // 1ms
+    // A pidfd is readable once the child has exited.
+    _pidFd = pidfdOpen(_pid);
+
+    if (_pidFd != -1) {
+        _selector.addReadable(_pidFd, this);
+    }
+    else {
+        _reapTimer = _selector.addTimer(this, REAP_POLL_MS, true);
+    }
+
+    _escalationTimer = _selector.addTimer(this, ESCALATION_MS, false);
+    _escalation      = 0;
+}
+
+void Tty::stopReap() {
+    if (_pidFd != -1) {
+        _selector.removeReadable(_pidFd);
+        ENFORCE_SYS(::close(_pidFd) != -1, "");
+        _pidFd = -1;
+    }
+
+    if (_reapTimer != -1) {
+        _selector.removeTimer(_reapTimer);
+        _reapTimer = -1;
+    }
+
+    if (_escalationTimer != -1) {
+        _selector.removeTimer(_escalationTimer);
+        _escalationTimer = -1;
     }
+}
+
+bool Tty::tryReap(int & exitCode) {
+    ASSERT(_pid != 0, "");
 
-    return false;
+    int  stat;
+    auto pid = TEMP_FAILURE_RETRY(::waitpid(_pid, &stat, WNOHANG));
+    ENFORCE_SYS(pid != -1, "::waitpid() failed.");
+
+    if (pid == 0) { return false; }
+
+    ENFORCE(pid == _pid, "pid mismatch.");
+    _pid = 0;
+    exitCode = WIFEXITED(stat) ? WEXITSTATUS(stat) : EXIT_FAILURE;
+    return true;
 }
 
 int Tty::waitReap() {
@@ -301,14 +485,38 @@ int Tty::waitReap() {
     return WIFEXITED(stat) ? WEXITSTATUS(stat) : EXIT_FAILURE;
 }
 
+void Tty::handleReap() {
+    int exitCode;
+
+    if (tryReap(exitCode)) {
+        stopReap();
+        // Last: the observer may delete us.
+        _observer.ttyExited(exitCode);
+    }
+}
+
 // I_Selector::I_ReadHandler implementation:
 
 void Tty::handleRead(int fd) throw () {
+    if (fd == _pidFd) {
+        handleReap();
+        return;
+    }
+
+    if (_reader) {
+        ASSERT(_reader->getFd() == fd, "");
+        handleReaderRead();
+        return;
+    }
+
     ASSERT(_fd == fd, "");
 
+    // Bounded in time and bytes so a flooding child can't keep the other
+    // windows waiting. If there's more, the selector brings us back.
     Timer   timer(1000 / _config.framesPerSecond);
     uint8_t buf[BUFSIZ];          // 8192 last time I looked.
-    auto    size = _config.syncTty ? 1 : sizeof buf;
+    auto    size  = _config.syncTty ? 1 : sizeof buf;
+    size_t  total = 0;
 
     do {
         auto rval = TEMP_FAILURE_RETRY(::read(_fd, static_cast<void *>(buf), size));
@@ -318,7 +526,7 @@ void Tty::handleRead(int fd) throw () {
                 case EAGAIN:
                     goto done;
                 case EIO:
-                    _observer.ttyExited(close());
+                    close();
                     goto done;
                 default:
                     FATAL("Unexpected error: " << errno << " " << ::strerror(errno));
@@ -330,9 +538,90 @@ void Tty::handleRead(int fd) throw () {
         else {
             _observer.ttyData(buf, rval);
             if (_config.syncTty) { _observer.ttySync(); }
+            total += rval;
+
+            // Don't keep the echo waiting behind the rest of the budget.
+            if (_echoExpected) {
+                _echoExpected = false;
+                goto done;
+            }
         }
-    } while (!timer.expired());
+    } while (total < _config.ttyReadBudget && !timer.expired());
 
 done:
     _observer.ttySync();
 }
+
+void Tty::handleReaderRead() throw () {
+    // As above, but the reads have already been done for us.
+    Timer  timer(1000 / _config.framesPerSecond);
+    size_t total = 0;
+
+    do {
+        const uint8_t * data;
+        size_t          size;
+
+        if (!_reader->peek(data, size)) { break; }
+
+        if (size == 0) {
+            close();
+            break;
+        }
+
+        _observer.ttyData(data, size);
+        _reader->pop();
+        total += size;
+
+        if (_echoExpected) {
+            _echoExpected = false;
+            break;
+        }
+    } while (total < _config.ttyReadBudget && !timer.expired());
+
+    _observer.ttySync();
+}
+
+// I_Selector::I_WriteHandler implementation:
+
+void Tty::handleWrite(int fd) throw () {
+    ASSERT(_fd == fd, "");
+    ASSERT(!_writeBuffer.empty(), "");
+
+    auto congested = isCongested();
+    auto rval      = writeSome(&_writeBuffer.front(), _writeBuffer.size());
+
+    if (_dumpWrites) {
+        _writeBuffer.clear();
+    }
+    else {
+        _writeBuffer.erase(_writeBuffer.begin(), _writeBuffer.begin() + rval);
+    }
+
+    if (_writeBuffer.empty()) {
+        _selector.removeWriteable(_fd);
+    }
+
+    if (congested && !isCongested()) {
+        _observer.ttyDrained();
+    }
+}
+
+// I_Selector::I_TimerHandler implementation:
+
+void Tty::handleTimer(int timer) throw () {
+    if (timer == _reapTimer) {
+        handleReap();
+    }
+    else {
+        ASSERT(timer == _escalationTimer, "");
+
+        auto & step = ESCALATION[_escalation++];
+        PRINT("Sending " << step.name << ".");
+        ::kill(_pid, step.signal);
+
+        // After SIGKILL it's just a matter of time.
+        if (_escalation != sizeof ESCALATION / sizeof ESCALATION[0]) {
+            _selector.armTimer(_escalationTimer, ESCALATION_MS);
+        }
+    }
+}
@@ -4,14 +4,19 @@
 #define COMMON__TTY__H
 
 #include "terminol/common/config.hxx"
+#include "terminol/common/tty_reader.hxx"
 #include "terminol/support/selector.hxx"
 #include "terminol/support/pattern.hxx"
 
 #include <vector>
 #include <string>
 
+class ShellPool;
+
 class Tty :
     protected I_Selector::I_ReadHandler,
+    protected I_Selector::I_WriteHandler,
+    protected I_Selector::I_TimerHandler,
     protected Uncopyable
 {
 public:
@@ -19,7 +24,8 @@ public:
     public:
         virtual void ttyData(const uint8_t * data, size_t size) throw () = 0;
         virtual void ttySync() throw () = 0;
-        virtual void ttyExited(int exitCode) throw () = 0;
+        virtual void ttyDrained() throw () = 0;     // below the high-water mark again
+        virtual void ttyExited(int exitCode) throw () = 0;    // reaped, after close()
 
     protected:
         ~I_Observer() {}
@@ -32,6 +38,14 @@ private:
     pid_t                  _pid;
     int                    _fd;
     bool                   _dumpWrites;
+    std::vector<uint8_t>   _writeBuffer;            // waiting for the fd to be writeable
+    bool                   _echoExpected;
+    TtyReader            * _reader;                 // when reading on a thread
+    bool                   _readsHeld;
+    int                    _pidFd;                  // -1 -> poll with _reapTimer
+    int                    _reapTimer;
+    int                    _escalationTimer;
+    size_t                 _escalation;             // signals sent so far
 
 public:
     struct Error {
@@ -41,35 +55,75 @@ public:
 
     typedef std::vector<std::string> Command;           // XXX questionable typedef
 
+    struct Options {                        // for one child, beyond the config
+        std::string              cwd;       // empty -> ours
+        std::vector<std::string> env;       // NAME=VALUE, over the rest
+    };
+
     Tty(I_Observer        & observer,
         I_Selector        & selector,
         const Config      & config,
         uint16_t            rows,
         uint16_t            cols,
         const std::string & windowId,
-        const Command     & command) throw (Error);
+        const Command     & command,
+        const Options     & options   = Options(),
+        ShellPool         * shellPool = nullptr) throw (Error);
 
     virtual ~Tty();
 
+    // Opens a pty and starts a shell (or command) on it. The master
+    // descriptor is returned through 'master'.
+    static pid_t spawn(const Config      & config,
+                       uint16_t            rows,
+                       uint16_t            cols,
+                       const std::string & windowId,
+                       const Command     & command,
+                       const Options     & options,
+                       int               & master) throw (Error);
+
     void resize(uint16_t rows, uint16_t cols);
-    void write(const uint8_t * buffer, size_t size);
+    void write(const uint8_t * buffer, size_t size);        // never drops
+    bool isCongested() const { return _writeBuffer.size() >= _config.ttyWriteHighWater; }
+    void expectEcho() { _echoExpected = true; }        // sync after the next read
+    void holdReads(bool hold);  // while the observer catches up
     bool hasSubprocess() const;
-    int  close();               // returns exit code
+    void close();               // ttyExited() follows once the child is reaped
 
 protected:
     void openPty(uint16_t            rows,
                  uint16_t            cols,
                  const std::string & windowId,
-                 const Command     & command) throw (Error);
-    void execShell(const std::string & windowId,
-                   const Command     & command);
-
-    bool pollReap(int msec, int & exitCode);
+                 const Command     & command,
+                 const Options     & options) throw (Error);
+    void attach(int master);
+    static pid_t spawnShell(const Config      & config,
+                            int                 master,
+                            int                 slave,
+                            const std::string & windowId,
+                            const Command     & command,
+                            const Options     & options) throw (Error);
+
+    size_t writeSome(const uint8_t * data, size_t size);
+
+    void startReap();
+    void stopReap();
+    bool tryReap(int & exitCode);
     int  waitReap();
+    void handleReap();
 
     // I_Selector::I_ReadHandler implementation:
 
     void handleRead(int fd) throw ();
+    void handleReaderRead() throw ();
+
+    // I_Selector::I_WriteHandler implementation:
+
+    void handleWrite(int fd) throw ();
+
+    // I_Selector::I_TimerHandler implementation:
+
+    void handleTimer(int timer) throw ();
 };
 
 #endif // COMMON__TTY__H
@@ -0,0 +1,166 @@
+// vi:noai:sw=4
+
+#include "terminol/common/tty_reader.hxx"
+#include "terminol/support/debug.hxx"
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+namespace {
+
+int makeEventFd() {
+    auto fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ENFORCE_SYS(fd != -1, "::eventfd() failed.");
+    return fd;
+}
+
+void signalEventFd(int fd) {
+    uint64_t one = 1;
+    ENFORCE_SYS(TEMP_FAILURE_RETRY(::write(fd, &one, sizeof one)) == sizeof one, "");
+}
+
+void clearEventFd(int fd) {
+    uint64_t count;
+    if (TEMP_FAILURE_RETRY(::read(fd, &count, sizeof count)) == -1) {
+        ENFORCE_SYS(errno == EAGAIN, "");
+    }
+}
+
+} // namespace {anonymous}
+
+TtyReader::TtyReader(int ptyFd, size_t slots, size_t slotBytes) :
+    _ptyFd(ptyFd),
+    _slots(slots),
+    _head(0),
+    _tail(0),
+    _readerWaiting(false),
+    _dataFd(makeEventFd()),
+    _spaceFd(makeEventFd()),
+    _stopFd(makeEventFd()),
+    _thread()
+{
+    ASSERT(slots != 0 && slotBytes != 0, "");
+    for (auto & slot : _slots) {
+        slot.data.resize(slotBytes);
+        slot.size = 0;
+    }
+
+    _thread = std::thread([this] { run(); });
+}
+
+TtyReader::~TtyReader() {
+    signalEventFd(_stopFd);
+    _thread.join();
+
+    ENFORCE_SYS(::close(_stopFd) != -1, "");
+    ENFORCE_SYS(::close(_spaceFd) != -1, "");
+    ENFORCE_SYS(::close(_dataFd) != -1, "");
+}
+
+bool TtyReader::peek(const uint8_t * & data, size_t & size) {
+    auto tail = _tail.load(std::memory_order_relaxed);
+
+    if (_head.load(std::memory_order_acquire) == tail) {
+        // Clear, then look again in case the reader slipped one in.
+        clearEventFd(_dataFd);
+        if (_head.load(std::memory_order_acquire) == tail) { return false; }
+        signalEventFd(_dataFd);
+    }
+
+    auto & slot = _slots[tail % _slots.size()];
+    data = &slot.data.front();
+    size = slot.size;
+    return true;
+}
+
+void TtyReader::pop() {
+    _tail.fetch_add(1);
+
+    if (_readerWaiting.exchange(false)) {
+        signalEventFd(_spaceFd);
+    }
+}
+
+void TtyReader::run() {
+    for (;;) {
+        if (!waitForSpace()) { return; }
+
+        struct pollfd fds[2] = {
+            { _ptyFd,  POLLIN, 0 },
+            { _stopFd, POLLIN, 0 }
+        };
+
+        if (TEMP_FAILURE_RETRY(::poll(fds, 2, -1)) == -1) {
+            FATAL("::poll() failed: " << ::strerror(errno));
+        }
+
+        if (fds[1].revents) { return; }
+
+        auto   head = _head.load(std::memory_order_relaxed);
+        auto & slot = _slots[head % _slots.size()];
+        bool   done = false;
+
+        // Fill the buffer while there's something to read.
+        slot.size = 0;
+        while (slot.size != slot.data.size()) {
+            auto rval = TEMP_FAILURE_RETRY(::read(_ptyFd, &slot.data[slot.size],
+                                                  slot.data.size() - slot.size));
+            if (rval > 0) {
+                slot.size += rval;
+            }
+            else if (rval == -1 && errno == EAGAIN) {
+                break;
+            }
+            else {
+                // EIO (or a zero read) once the child has gone.
+                done = true;
+                break;
+            }
+        }
+
+        if (slot.size != 0) {
+            _head.store(head + 1, std::memory_order_release);
+            signalEventFd(_dataFd);
+
+            if (done) {
+                // Still need a slot for the end marker.
+                if (!waitForSpace()) { return; }
+                head  = _head.load(std::memory_order_relaxed);
+                _slots[head % _slots.size()].size = 0;
+                _head.store(head + 1, std::memory_order_release);
+                signalEventFd(_dataFd);
+            }
+        }
+        else if (done) {
+            _head.store(head + 1, std::memory_order_release);
+            signalEventFd(_dataFd);
+        }
+
+        if (done) { return; }
+    }
+}
+
+bool TtyReader::waitForSpace() {
+    for (;;) {
+        _readerWaiting.store(true);
+
+        if (_head.load(std::memory_order_relaxed) - _tail.load() < _slots.size()) {
+            _readerWaiting.store(false);
+            return true;
+        }
+
+        struct pollfd fds[2] = {
+            { _spaceFd, POLLIN, 0 },
+            { _stopFd,  POLLIN, 0 }
+        };
+
+        if (TEMP_FAILURE_RETRY(::poll(fds, 2, -1)) == -1) {
+            FATAL("::poll() failed: " << ::strerror(errno));
+        }
+
+        if (fds[1].revents) { return false; }
+
+        clearEventFd(_spaceFd);
+    }
+}
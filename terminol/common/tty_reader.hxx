@@ -0,0 +1,58 @@
+// vi:noai:sw=4
+
+#ifndef COMMON__TTY_READER__HXX
+#define COMMON__TTY_READER__HXX
+
+#include "terminol/support/pattern.hxx"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// Drains a pty on its own thread so the child keeps running while the
+// main thread parses and draws. The reader fills a ring of large
+// buffers; the handoff is a pair of atomic counters (one producer, one
+// consumer). The main thread waits on an eventfd that stays readable
+// while there are filled buffers. When the ring is full the reader
+// sleeps until a buffer is handed back. A filled buffer of size zero
+// means the pty is finished (the child has gone).
+//
+
+class TtyReader : protected Uncopyable {
+    struct Slot {
+        std::vector<uint8_t> data;
+        size_t               size;
+    };
+
+    const int              _ptyFd;
+    std::vector<Slot>      _slots;
+    std::atomic<size_t>    _head;           // filled, written by the reader
+    std::atomic<size_t>    _tail;           // consumed, written by the main thread
+    std::atomic<bool>      _readerWaiting;  // for a free slot
+    int                    _dataFd;         // eventfd: reader -> main
+    int                    _spaceFd;        // eventfd: main -> reader
+    int                    _stopFd;         // eventfd: main -> reader
+    std::thread            _thread;
+
+public:
+    TtyReader(int ptyFd, size_t slots, size_t slotBytes);
+    ~TtyReader();                           // stops the thread
+
+    // Register this with the selector instead of the pty.
+    int  getFd() const { return _dataFd; }
+
+    // Main thread: look at the oldest filled buffer, then hand it back.
+    // peek() returns false, and clears the eventfd, when there are none.
+    bool peek(const uint8_t * & data, size_t & size);
+    void pop();
+
+protected:
+    void run();
+    bool waitForSpace();                    // false if stopped
+};
+
+#endif // COMMON__TTY_READER__HXX
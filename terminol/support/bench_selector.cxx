@@ -0,0 +1,158 @@
+// vi:noai:sw=4
+
+#include "terminol/support/selector.hxx"
+#include "terminol/support/conv.hxx"
+#include "terminol/support/time.hxx"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <unistd.h>
+#include <pty.h>
+#include <termios.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// Many busy ptys: a child process writes into the slave sides while
+// we read the master sides through each selector backend. Reports
+// throughput, wakeups, reads and context switches. For exact system
+// call counts run it under 'strace -c -f'.
+
+namespace {
+
+class Reader : protected I_Selector::I_ReadHandler {
+    I_Selector       & _selector;
+    std::vector<int>   _fds;
+    size_t             _bytes;
+    size_t             _reads;
+
+public:
+    Reader(I_Selector & selector, const std::vector<int> & fds) :
+        _selector(selector), _fds(fds), _bytes(0), _reads(0)
+    {
+        for (auto fd : _fds) { _selector.addReadable(fd, this); }
+    }
+
+    virtual ~Reader() {
+        for (auto fd : _fds) { _selector.removeReadable(fd); }
+    }
+
+    size_t getBytes() const { return _bytes; }
+    size_t getReads() const { return _reads; }
+
+protected:
+    // I_Selector::I_ReadHandler implementation:
+
+    // One read per wakeup, as Tty::handleRead does with a busy child.
+    void handleRead(int fd) throw () {
+        uint8_t buf[BUFSIZ];
+        auto rval = TEMP_FAILURE_RETRY(::read(fd, buf, sizeof buf));
+        ++_reads;
+        if (rval > 0) { _bytes += rval; }
+        else { ENFORCE(rval == -1 && errno == EAGAIN, "Unexpected read: " << rval); }
+    }
+};
+
+void openPtys(size_t count, std::vector<int> & masters, std::vector<int> & slaves) {
+    for (size_t i = 0; i != count; ++i) {
+        int master, slave;
+        struct termios tios;
+        ::cfmakeraw(&tios);
+        ENFORCE_SYS(::openpty(&master, &slave, nullptr, &tios, nullptr) != -1, "");
+        ENFORCE_SYS(::fcntl(master, F_SETFL, ::fcntl(master, F_GETFL) | O_NONBLOCK) != -1, "");
+        masters.push_back(master);
+        slaves.push_back(slave);
+    }
+}
+
+void writeAll(const std::vector<int> & slaves, size_t bytesEach) {
+    std::vector<uint8_t> chunk(1024, 'x');
+    for (size_t done = 0; done < bytesEach; done += chunk.size()) {
+        for (auto fd : slaves) {
+            ENFORCE_SYS(TEMP_FAILURE_RETRY(::write(fd, &chunk.front(), chunk.size())) ==
+                        static_cast<ssize_t>(chunk.size()), "");
+        }
+    }
+}
+
+long contextSwitches() {
+    struct rusage usage;
+    ENFORCE_SYS(::getrusage(RUSAGE_SELF, &usage) != -1, "");
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+template <class S>
+void bench(const char * name, S & selector, size_t ptys, size_t bytesEach) {
+    std::vector<int> masters, slaves;
+    openPtys(ptys, masters, slaves);
+
+    auto pid = ::fork();
+    ENFORCE_SYS(pid != -1, "");
+
+    if (pid == 0) {
+        for (auto fd : masters) { ::close(fd); }
+        writeAll(slaves, bytesEach);
+        // Let the parent drain before the slaves go away.
+        ::pause();
+        ::_exit(0);
+    }
+
+    {
+        Reader reader(selector, masters);
+
+        auto   t0       = monotonicMicroseconds();
+        auto   cs0      = contextSwitches();
+        size_t wakeups  = 0;
+        auto   total    = ptys * ((bytesEach + 1023) / 1024 * 1024);
+
+        while (reader.getBytes() < total) {
+            selector.animate();
+            ++wakeups;
+        }
+
+        auto t1  = monotonicMicroseconds();
+        auto cs1 = contextSwitches();
+
+        std::cout
+            << std::setw(6) << name << ": "
+            << std::fixed << std::setprecision(1)
+            << total / 1e6 / ((t1 - t0) / 1e6) << " MB/s, "
+            << wakeups << " wakeups, "
+            << reader.getReads() << " reads ("
+            << std::setprecision(2) << double(reader.getReads()) / wakeups << " per wakeup), "
+            << cs1 - cs0 << " context switches"
+            << std::endl;
+    }
+
+    ::kill(pid, SIGTERM);
+    ENFORCE_SYS(::waitpid(pid, nullptr, 0) == pid, "");
+
+    for (auto fd : masters) { ::close(fd); }
+    for (auto fd : slaves)  { ::close(fd); }
+}
+
+} // namespace {anonymous}
+
+int main(int argc, char * argv[]) {
+    size_t ptys      = argc > 1 ? unstringify<size_t>(argv[1]) : 64;
+    size_t bytesEach = argc > 2 ? unhumanSize(argv[2]) : 4 * 1024 * 1024;
+
+    std::cout << ptys << " ptys, " << humanSize(bytesEach) << " each" << std::endl;
+
+    {
+        EPollSelector selector;
+        bench("epoll", selector, ptys, bytesEach);
+    }
+
+    try {
+        URingSelector selector;
+        bench("uring", selector, ptys, bytesEach);
+    }
+    catch (const URingSelector::Error & ex) {
+        std::cout << "uring: " << ex.message << std::endl;
+    }
+
+    return 0;
+}
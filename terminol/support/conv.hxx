@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <sstream>
+#include <limits>
 
 struct ParseError {
     explicit ParseError(const std::string & message_) : message(message_) {}
@@ -154,4 +155,32 @@ inline std::string humanSize(size_t bytes) {
     return ost.str();
 }
 
+// The inverse of humanSize(), e.g. "512", "64K", "64KB", "2G".
+inline size_t unhumanSize(const std::string & str) throw (ParseError) {
+    std::istringstream ist(str);
+    ist >> std::ws;
+    // Extraction into an unsigned would wrap "-1" around.
+    if (ist.peek() == '-') { throw ParseError("Negative size: '" + str + "'"); }
+    size_t value;
+    ist >> value;
+    if (ist.fail()) { throw ParseError("Failed to unstringify size: '" + str + "'"); }
+
+    std::string unit;
+    ist >> unit;
+    if (!unit.empty() && unit.back() == 'B') { unit.pop_back(); }
+
+    int shift;
+    if      (unit.empty()) { shift = 0; }
+    else if (unit == "K")  { shift = 10; }
+    else if (unit == "M")  { shift = 20; }
+    else if (unit == "G")  { shift = 30; }
+    else { throw ParseError("Bad size unit: '" + str + "'"); }
+
+    if (value > std::numeric_limits<size_t>::max() >> shift) {
+        throw ParseError("Size too large: '" + str + "'");
+    }
+
+    return value << shift;
+}
+
 #endif // SUPPORT__CONV__HXX
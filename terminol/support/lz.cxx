@@ -0,0 +1,137 @@
+// vi:noai:sw=4
+
+#include "terminol/support/lz.hxx"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lz {
+
+namespace {
+
+const size_t MIN_MATCH  = 4;
+const size_t MAX_OFFSET = 0xFFFF;
+const int    HASH_BITS  = 12;
+
+inline uint32_t read32(const uint8_t * p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+inline uint32_t hash4(const uint8_t * p) {
+    return (read32(p) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+void putLength(size_t length, std::vector<uint8_t> & out) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+void putSequence(const uint8_t * literals, size_t literalLength,
+                 size_t offset, size_t matchLength,
+                 std::vector<uint8_t> & out) {
+    auto    extra = matchLength != 0 ? matchLength - MIN_MATCH : 0;
+    uint8_t token = (std::min<size_t>(literalLength, 15) << 4) |
+                     std::min<size_t>(extra, 15);
+
+    out.push_back(token);
+    if (literalLength >= 15) { putLength(literalLength - 15, out); }
+    out.insert(out.end(), literals, literals + literalLength);
+
+    if (matchLength != 0) {
+        out.push_back(static_cast<uint8_t>(offset));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        if (extra >= 15) { putLength(extra - 15, out); }
+    }
+}
+
+bool getLength(const uint8_t * & in, const uint8_t * end, size_t & length) {
+    uint8_t byte;
+    do {
+        if (in == end) { return false; }
+        byte    = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace {anonymous}
+
+void compress(const uint8_t * data, size_t size, std::vector<uint8_t> & out) {
+    uint32_t table[1 << HASH_BITS];
+    std::fill(table, table + (1 << HASH_BITS), 0);
+
+    const uint8_t * anchor = data;
+    size_t          i      = 0;
+
+    while (size >= MIN_MATCH && i <= size - MIN_MATCH) {
+        auto h         = hash4(data + i);
+        auto candidate = table[h];
+        table[h]       = static_cast<uint32_t>(i);
+
+        if (candidate < i && i - candidate <= MAX_OFFSET &&
+            read32(data + candidate) == read32(data + i))
+        {
+            auto length = MIN_MATCH;
+            while (i + length < size && data[candidate + length] == data[i + length]) {
+                ++length;
+            }
+
+            putSequence(anchor, data + i - anchor, i - candidate, length, out);
+
+            i     += length;
+            anchor = data + i;
+        }
+        else {
+            ++i;
+        }
+    }
+
+    putSequence(anchor, data + size - anchor, 0, 0, out);
+}
+
+bool decompress(const uint8_t * data, size_t size, uint8_t * out, size_t outSize) {
+    const uint8_t * in     = data;
+    const uint8_t * inEnd  = data + size;
+    uint8_t       * op     = out;
+    uint8_t       * opEnd  = out + outSize;
+
+    while (in != inEnd) {
+        auto   token         = *in++;
+        size_t literalLength = token >> 4;
+
+        if (literalLength == 15 && !getLength(in, inEnd, literalLength)) { return false; }
+        if (static_cast<size_t>(inEnd - in) < literalLength) { return false; }
+        if (static_cast<size_t>(opEnd - op) < literalLength) { return false; }
+
+        std::memcpy(op, in, literalLength);
+        in += literalLength;
+        op += literalLength;
+
+        if (in == inEnd) { break; }     // Last sequence, no match.
+
+        if (inEnd - in < 2) { return false; }
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !getLength(in, inEnd, matchLength)) { return false; }
+        matchLength += MIN_MATCH;
+
+        if (offset == 0 || static_cast<size_t>(op - out) < offset) { return false; }
+        if (static_cast<size_t>(opEnd - op) < matchLength) { return false; }
+
+        // Overlapping copies are how runs are encoded, so byte by byte.
+        const uint8_t * match = op - offset;
+        for (size_t j = 0; j != matchLength; ++j) { op[j] = match[j]; }
+        op += matchLength;
+    }
+
+    return op == opEnd;
+}
+
+} // namespace lz
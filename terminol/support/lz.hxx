@@ -0,0 +1,30 @@
+// vi:noai:sw=4
+
+#ifndef SUPPORT__LZ__HXX
+#define SUPPORT__LZ__HXX
+
+#include <vector>
+
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// A small LZ77 codec in the style of LZ4: a stream of sequences, each a
+// token (literal length in the high nibble, match length - 4 in the low
+// nibble), extra length bytes when a nibble is 15, the literals, and a
+// two byte little-endian match offset. The last sequence has no match.
+// It favours speed over ratio; history lines are very repetitive anyway.
+//
+
+namespace lz {
+
+// Appends the compressed form of [data, data + size) to out.
+void compress(const uint8_t * data, size_t size, std::vector<uint8_t> & out);
+
+// Returns false if the input is corrupt or doesn't decompress to exactly
+// size bytes.
+bool decompress(const uint8_t * data, size_t size, uint8_t * out, size_t outSize);
+
+} // namespace lz
+
+#endif // SUPPORT__LZ__HXX
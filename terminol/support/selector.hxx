@@ -4,14 +4,24 @@
 #define SUPPORT__SELECTOR__HXX
 
 #include "terminol/support/debug.hxx"
+#include "terminol/support/pattern.hxx"
 
 #include <vector>
+#include <map>
 #include <algorithm>
 
+#include <string>
+#include <cstring>
+
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/select.h>
 #include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
 
 class I_Selector {
 public:
@@ -24,14 +34,141 @@ public:
         ~I_ReadHandler() {}
     };
 
-    virtual void addReadable(int fd, I_ReadHandler * handler) = 0;
+    class I_WriteHandler {
+    public:
+        virtual void handleWrite(int fd) throw () = 0;
+
+    protected:
+        I_WriteHandler() {}
+        ~I_WriteHandler() {}
+    };
+
+    class I_TimerHandler {
+    public:
+        virtual void handleTimer(int timer) throw () = 0;
+
+    protected:
+        I_TimerHandler() {}
+        ~I_TimerHandler() {}
+    };
+
+    // An edge-triggered handler must consume until EAGAIN. Selectors that
+    // can't do edges deliver levels, which such a handler copes with too.
+    virtual void addReadable(int fd, I_ReadHandler * handler, bool edge = false) = 0;
     virtual void removeReadable(int fd) = 0;
 
+    virtual void addWriteable(int fd, I_WriteHandler * handler) = 0;
+    virtual void removeWriteable(int fd) = 0;
+
+    // Timers are one-shot or periodic. Either way the returned id stays
+    // valid until removeTimer(); a one-shot timer can be re-armed.
+    virtual int  addTimer(I_TimerHandler * handler, uint32_t milliseconds, bool periodic) = 0;
+    virtual void armTimer(int timer, uint32_t milliseconds) = 0;
+    virtual void removeTimer(int timer) = 0;
+
 protected:
     I_Selector() {}
     ~I_Selector() {}
 };
 
+//
+// A timerfd registered with a selector as a readable.
+//
+
+class SelectorTimer : protected I_Selector::I_ReadHandler {
+    I_Selector                 & _selector;
+    I_Selector::I_TimerHandler * _handler;
+    bool                         _periodic;
+    int                          _fd;
+
+public:
+    SelectorTimer(I_Selector                 & selector,
+                  I_Selector::I_TimerHandler * handler,
+                  uint32_t                     milliseconds,
+                  bool                         periodic) :
+        _selector(selector),
+        _handler(handler),
+        _periodic(periodic),
+        _fd(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+    {
+        ENFORCE_SYS(_fd != -1, "::timerfd_create() failed.");
+        arm(milliseconds);
+        _selector.addReadable(_fd, this, true);
+    }
+
+    virtual ~SelectorTimer() {
+        _selector.removeReadable(_fd);
+        ENFORCE_SYS(::close(_fd) != -1, "");
+    }
+
+    int  getFd() const { return _fd; }
+
+    void arm(uint32_t milliseconds) {
+        struct itimerspec spec;
+        std::memset(&spec, 0, sizeof spec);
+        spec.it_value.tv_sec  = milliseconds / 1000;
+        spec.it_value.tv_nsec = (milliseconds % 1000) * 1000000;
+        // A zero it_value would disarm.
+        if (milliseconds == 0) { spec.it_value.tv_nsec = 1; }
+        if (_periodic) { spec.it_interval = spec.it_value; }
+        ENFORCE_SYS(::timerfd_settime(_fd, 0, &spec, nullptr) != -1, "");
+    }
+
+protected:
+    // I_Selector::I_ReadHandler implementation:
+
+    void handleRead(int fd) throw () {
+        ASSERT(fd == _fd, "");
+        uint64_t expirations;
+        if (TEMP_FAILURE_RETRY(::read(_fd, &expirations, sizeof expirations)) == -1) {
+            ENFORCE(errno == EAGAIN, "");       // Re-armed since it fired.
+            return;
+        }
+        // Last: the handler may remove us.
+        _handler->handleTimer(fd);
+    }
+};
+
+//
+// A selector's timers, by id (the timerfd). The selector clears the table
+// first thing in its destructor, while it can still unregister the fds.
+//
+
+class SelectorTimers : protected Uncopyable {
+    I_Selector                    & _selector;
+    std::map<int, SelectorTimer *>  _timers;
+
+public:
+    explicit SelectorTimers(I_Selector & selector) : _selector(selector), _timers() {}
+
+    ~SelectorTimers() { clear(); }
+
+    int add(I_Selector::I_TimerHandler * handler, uint32_t milliseconds, bool periodic) {
+        auto timer = new SelectorTimer(_selector, handler, milliseconds, periodic);
+        _timers.insert(std::make_pair(timer->getFd(), timer));
+        return timer->getFd();
+    }
+
+    void arm(int timer, uint32_t milliseconds) {
+        auto iter = _timers.find(timer);
+        ASSERT(iter != _timers.end(), "");
+        iter->second->arm(milliseconds);
+    }
+
+    void remove(int timer) {
+        auto iter = _timers.find(timer);
+        ASSERT(iter != _timers.end(), "");
+        delete iter->second;
+        _timers.erase(iter);
+    }
+
+    // Frees the timers that were never removed.
+    void clear() {
+        for (auto & p : _timers) { delete p.second; }
+        _timers.clear();
+    }
+};
+
 //
 //
 //
@@ -43,36 +180,60 @@ class SelectSelector : public I_Selector {
         I_ReadHandler * handler;
     };
 
-    std::vector<Reg> _regs;
+    struct WReg {
+        WReg(int fd_, I_WriteHandler * handler_) : fd(fd_), handler(handler_) {}
+        int              fd;
+        I_WriteHandler * handler;
+    };
+
+    std::vector<Reg>                _regs;
+    std::vector<WReg>               _wregs;
+    SelectorTimers                  _timers;
 
 public:
-    SelectSelector() {}
+    SelectSelector() : _regs(), _wregs(), _timers(*this) {}
 
     virtual ~SelectSelector() {
+        _timers.clear();
         ASSERT(_regs.empty(), "");
+        ASSERT(_wregs.empty(), "");
     }
 
     void animate() {
         ASSERT(!_regs.empty(), "");
 
-        fd_set readFds;
+        fd_set readFds, writeFds;
         int max = -1;
 
         FD_ZERO(&readFds);
+        FD_ZERO(&writeFds);
 
         for (auto reg : _regs) {
             FD_SET(reg.fd, &readFds);
             max = std::max(max, reg.fd);
         }
 
+        for (auto wreg : _wregs) {
+            FD_SET(wreg.fd, &writeFds);
+            max = std::max(max, wreg.fd);
+        }
+
         //PRINT("Selecting, max=" << max);
         ENFORCE_SYS(TEMP_FAILURE_RETRY(
-            ::select(max + 1, &readFds, nullptr, nullptr, nullptr)) != -1, "");
+            ::select(max + 1, &readFds, &writeFds, nullptr, nullptr)) != -1, "");
+
+        // Copy the vectors in case they change during dispatch.
+        auto wregsCopy = _wregs;
+        for (auto wreg : wregsCopy) {
+            if (FD_ISSET(wreg.fd, &writeFds) && isWriteable(wreg.fd)) {
+                //PRINT("writeable: " << wreg.fd);
+                wreg.handler->handleWrite(wreg.fd);
+            }
+        }
 
-        // Copy the vector in case it changes during dispatch.
         auto regsCopy = _regs;
         for (auto reg : regsCopy) {
-            if (FD_ISSET(reg.fd, &readFds)) {
+            if (FD_ISSET(reg.fd, &readFds) && isReadable(reg.fd)) {
                 //PRINT("readable: " << reg.fd);
                 reg.handler->handleRead(reg.fd);
             }
@@ -81,10 +242,9 @@ public:
 
     // I_Selector implementation:
 
-    void addReadable(int fd, I_ReadHandler * handler) {
+    void addReadable(int fd, I_ReadHandler * handler, bool UNUSED(edge) = false) {
         //PRINT("Adding readable: " << fd);
-        ASSERT(std::find_if(_regs.begin(), _regs.end(),
-                            [fd](Reg reg) { return reg.fd == fd; }) == _regs.end(), "");
+        ASSERT(!isReadable(fd), "");
         _regs.push_back(Reg(fd, handler));
     }
 
@@ -95,6 +255,44 @@ public:
         ASSERT(iter != _regs.end(), "");
         _regs.erase(iter);
     }
+
+    void addWriteable(int fd, I_WriteHandler * handler) {
+        //PRINT("Adding writeable: " << fd);
+        ASSERT(!isWriteable(fd), "");
+        _wregs.push_back(WReg(fd, handler));
+    }
+
+    void removeWriteable(int fd) {
+        //PRINT("Removing writeable: " << fd);
+        auto iter = std::find_if(_wregs.begin(), _wregs.end(),
+                                 [fd](WReg wreg) { return wreg.fd == fd; });
+        ASSERT(iter != _wregs.end(), "");
+        _wregs.erase(iter);
+    }
+
+    int addTimer(I_TimerHandler * handler, uint32_t milliseconds, bool periodic) {
+        return _timers.add(handler, milliseconds, periodic);
+    }
+
+    void armTimer(int timer, uint32_t milliseconds) {
+        _timers.arm(timer, milliseconds);
+    }
+
+    void removeTimer(int timer) {
+        _timers.remove(timer);
+    }
+
+protected:
+    // A handler may have removed (or closed) an fd earlier in the dispatch.
+    bool isReadable(int fd) const {
+        return std::find_if(_regs.begin(), _regs.end(),
+                            [fd](Reg reg) { return reg.fd == fd; }) != _regs.end();
+    }
+
+    bool isWriteable(int fd) const {
+        return std::find_if(_wregs.begin(), _wregs.end(),
+                            [fd](WReg wreg) { return wreg.fd == fd; }) != _wregs.end();
+    }
 };
 
 //
@@ -102,11 +300,22 @@ public:
 //
 
 class EPollSelector : public I_Selector {
-    int                            _fd;
-    std::map<int, I_ReadHandler *> _regs;
+    struct Reg {
+        Reg() : readHandler(nullptr), writeHandler(nullptr), edge(false), events(0) {}
+        I_ReadHandler  * readHandler;
+        I_WriteHandler * writeHandler;
+        bool             edge;
+        uint32_t         events;        // as registered with the kernel
+    };
+
+    static const int MAX_EVENTS = 64;
+
+    int                             _fd;
+    std::map<int, Reg>              _regs;
+    SelectorTimers                  _timers;
 
 public:
-    EPollSelector() {
+    EPollSelector() : _fd(-1), _regs(), _timers(*this) {
         _fd = ::epoll_create1(0);
         ENFORCE_SYS(_fd != -1, "");
         int flags;
@@ -116,11 +325,11 @@ public:
     }
 
     virtual ~EPollSelector() {
+        _timers.clear();
         ENFORCE_SYS(::close(_fd) != -1, "");
     }
 
     void animate() {
-        const int MAX_EVENTS = 8;
         struct epoll_event event_array[MAX_EVENTS];
 
         auto n = TEMP_FAILURE_RETRY(::epoll_wait(_fd, event_array, MAX_EVENTS, -1));
@@ -138,35 +347,93 @@ public:
                 ERROR("Error on fd: " << fd);
             }
 
+            // Drain output first, the reply to it may already be waiting.
+            // Handlers may remove registrations, so look up each time.
+            if (events & (EPOLLERR | EPOLLHUP | EPOLLOUT)) {
+                auto iter = _regs.find(fd);
+                if (iter != _regs.end() && iter->second.writeHandler) {
+                    iter->second.writeHandler->handleWrite(fd);
+                }
+            }
+
             if (events & (EPOLLHUP | EPOLLIN)) {
                 auto iter = _regs.find(fd);
-                ASSERT(iter != _regs.end(), "");
-                auto handler = iter->second;
-                handler->handleRead(fd);
+                if (iter != _regs.end() && iter->second.readHandler) {
+                    iter->second.readHandler->handleRead(fd);
+                }
             }
         }
     }
 
     // I_Selector implementation:
 
-    void addReadable(int fd, I_ReadHandler * handler) {
-        ASSERT(_regs.find(fd) == _regs.end(), "");
+    void addReadable(int fd, I_ReadHandler * handler, bool edge = false) {
+        auto & reg = _regs[fd];
+        ASSERT(!reg.readHandler, "");
+        reg.readHandler = handler;
+        reg.edge        = edge;
+        update(fd);
+    }
 
-        struct epoll_event event;
-        std::memset(&event, 0, sizeof event);
-        event.data.fd = fd;
+    void removeReadable(int fd) {
+        auto iter = _regs.find(fd);
+        ASSERT(iter != _regs.end() && iter->second.readHandler, "");
+        iter->second.readHandler = nullptr;
+        iter->second.edge        = false;
+        update(fd);
+    }
 
-        event.events = EPOLLIN;
-        ENFORCE_SYS(::epoll_ctl(_fd, EPOLL_CTL_ADD, fd, &event) != -1, "");
-        _regs.insert(std::make_pair(fd, handler));
+    void addWriteable(int fd, I_WriteHandler * handler) {
+        auto & reg = _regs[fd];
+        ASSERT(!reg.writeHandler, "");
+        reg.writeHandler = handler;
+        update(fd);
     }
 
-    void removeReadable(int fd) {
+    void removeWriteable(int fd) {
         auto iter = _regs.find(fd);
-        ASSERT(iter != _regs.end(), "");
+        ASSERT(iter != _regs.end() && iter->second.writeHandler, "");
+        iter->second.writeHandler = nullptr;
+        update(fd);
+    }
 
-        ENFORCE_SYS(::epoll_ctl(_fd, EPOLL_CTL_DEL, fd, nullptr) != -1, "");
-        _regs.erase(iter);
+    int addTimer(I_TimerHandler * handler, uint32_t milliseconds, bool periodic) {
+        return _timers.add(handler, milliseconds, periodic);
+    }
+
+    void armTimer(int timer, uint32_t milliseconds) {
+        _timers.arm(timer, milliseconds);
+    }
+
+    void removeTimer(int timer) {
+        _timers.remove(timer);
+    }
+
+protected:
+    // Bring the kernel's interest in fd into line with its handlers,
+    // forgetting it when there are none left.
+    void update(int fd) {
+        auto & reg = _regs[fd];
+
+        uint32_t events = 0;
+        if (reg.readHandler)  { events |= EPOLLIN;  }
+        if (reg.writeHandler) { events |= EPOLLOUT; }
+        if (events != 0 && reg.edge) { events |= EPOLLET; }
+
+        if (events == 0) {
+            ENFORCE_SYS(::epoll_ctl(_fd, EPOLL_CTL_DEL, fd, nullptr) != -1, "");
+            _regs.erase(fd);
+        }
+        else {
+            struct epoll_event event;
+            std::memset(&event, 0, sizeof event);
+            event.data.fd = fd;
+            event.events  = events;
+
+            auto op = reg.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            ENFORCE_SYS(::epoll_ctl(_fd, op, fd, &event) != -1, "");
+            reg.events = events;
+        }
     }
 };
 
@@ -174,7 +441,387 @@ public:
 //
 //
 
-//typedef SelectSelector Selector;
-typedef EPollSelector Selector;
+//
+// io_uring, driven with raw system calls. Interest is expressed as poll
+// requests. Edge-triggered readers get a single multishot poll; level
+// interest uses one-shot polls that are re-armed after dispatch. Either
+// way the new requests ride along with the next wait, so a wakeup costs
+// one io_uring_enter() however many fds were busy.
+//
+
+class URingSelector : public I_Selector {
+    struct Reg {
+        Reg() : readHandler(nullptr), writeHandler(nullptr), edge(false),
+                readCookie(0), writeCookie(0), readArmed(false), writeArmed(false) {}
+        I_ReadHandler  * readHandler;
+        I_WriteHandler * writeHandler;
+        bool             edge;
+        uint32_t         readCookie;    // tells a live poll from a cancelled one
+        uint32_t         writeCookie;
+        bool             readArmed;
+        bool             writeArmed;
+    };
+
+    enum { READ = 0, WRITE = 1 };
+
+    static const uint64_t REMOVE_TAG = 0;
+    static const unsigned ENTRIES    = 256;
+
+    int                             _fd;
+    // Submission ring:
+    void                          * _sqRing;
+    size_t                          _sqRingBytes;
+    unsigned                      * _sqHead;
+    unsigned                      * _sqTail;
+    unsigned                        _sqFilled;      // our tail, published by enter()
+    unsigned                        _sqMask;
+    unsigned                      * _sqArray;
+    struct io_uring_sqe           * _sqes;
+    size_t                          _sqesBytes;
+    unsigned                        _pending;       // queued, not yet submitted
+    // Completion ring:
+    void                          * _cqRing;
+    size_t                          _cqRingBytes;
+    unsigned                      * _cqHead;
+    unsigned                      * _cqTail;
+    unsigned                        _cqMask;
+    struct io_uring_cqe           * _cqes;
+    //
+    uint32_t                        _nextCookie;
+    std::map<int, Reg>              _regs;
+    SelectorTimers                  _timers;
+
+public:
+    struct Error {
+        explicit Error(const std::string & message_) : message(message_) {}
+        std::string message;
+    };
+
+    URingSelector() throw (Error) :
+        _fd(-1),
+        _sqRing(MAP_FAILED), _sqRingBytes(0),
+        _sqHead(nullptr), _sqTail(nullptr), _sqFilled(0), _sqMask(0), _sqArray(nullptr),
+        _sqes(static_cast<struct io_uring_sqe *>(MAP_FAILED)), _sqesBytes(0),
+        _pending(0),
+        _cqRing(MAP_FAILED), _cqRingBytes(0),
+        _cqHead(nullptr), _cqTail(nullptr), _cqMask(0), _cqes(nullptr),
+        _nextCookie(1),
+        _regs(),
+        _timers(*this)
+    {
+        struct io_uring_params params;
+        std::memset(&params, 0, sizeof params);
+
+        _fd = ::syscall(__NR_io_uring_setup, ENTRIES, &params);
+        if (_fd == -1) {
+            throw Error(std::string("io_uring_setup() failed: ") + ::strerror(errno));
+        }
+
+        auto guard = scopeGuard([&] { unmap(); ::close(_fd); });
+
+        // Multishot poll arrived with resource tags (5.13). Without NODROP
+        // a completion burst could silently lose events.
+        const uint32_t required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+                                  IORING_FEAT_RSRC_TAGS;
+        if ((params.features & required) != required) {
+            throw Error("io_uring lacks required features.");
+        }
+
+        _sqRingBytes = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                params.cq_off.cqes  + params.cq_entries * sizeof(struct io_uring_cqe));
+        _sqRing = ::mmap(nullptr, _sqRingBytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        if (_sqRing == MAP_FAILED) { throw Error("Failed to map io_uring rings."); }
+
+        // With IORING_FEAT_SINGLE_MMAP both rings share the mapping.
+        _cqRing      = _sqRing;
+        _cqRingBytes = 0;
+
+        _sqesBytes = params.sq_entries * sizeof(struct io_uring_sqe);
+        _sqes = static_cast<struct io_uring_sqe *>(
+            ::mmap(nullptr, _sqesBytes, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES));
+        if (_sqes == MAP_FAILED) { throw Error("Failed to map io_uring entries."); }
+
+        auto sq  = static_cast<uint8_t *>(_sqRing);
+        _sqHead  = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        _sqTail  = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        _sqMask  = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        _sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        _sqFilled = *_sqTail;
+
+        auto cq  = static_cast<uint8_t *>(_cqRing);
+        _cqHead  = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        _cqTail  = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        _cqMask  = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        _cqes    = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        int flags;
+        ENFORCE_SYS((flags = ::fcntl(_fd, F_GETFD)) != -1, "");
+        flags |= FD_CLOEXEC;
+        ENFORCE_SYS(::fcntl(_fd, F_SETFD, flags) != -1, "");
+
+        guard.dismiss();
+    }
+
+    virtual ~URingSelector() {
+        _timers.clear();
+        unmap();
+        ENFORCE_SYS(::close(_fd) != -1, "");
+    }
+
+    void animate() {
+        // Submit whatever is queued and wait for at least one completion.
+        for (;;) {
+            if (enter(1, IORING_ENTER_GETEVENTS) != -1) {
+                break;
+            }
+            else if (errno == EBUSY) {
+                // Completions are backed up, drain them first.
+                break;
+            }
+            ENFORCE_SYS(errno == EINTR, "io_uring_enter() failed.");
+        }
+
+        // Take the whole batch before dispatching, handlers may queue more.
+        std::vector<struct io_uring_cqe> batch;
+        auto head = *_cqHead;
+        auto tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) { batch.push_back(_cqes[head & _cqMask]); }
+        __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+
+        for (auto & cqe : batch) {
+            if (cqe.user_data == REMOVE_TAG) { continue; }
+
+            auto cookie = static_cast<uint32_t>(cqe.user_data >> 32);
+            auto fd     = static_cast<int>((cqe.user_data & 0xFFFFFFFF) >> 1);
+            auto kind   = static_cast<int>(cqe.user_data & 1);
+
+            // Handlers may remove registrations, so look up each time.
+            auto iter = _regs.find(fd);
+            if (iter == _regs.end()) { continue; }
+            auto & reg = iter->second;
+
+            if (kind == READ) {
+                if (!reg.readHandler || reg.readCookie != cookie) { continue; }
+                if (!(cqe.flags & IORING_CQE_F_MORE)) { reg.readArmed = false; }
+            }
+            else {
+                if (!reg.writeHandler || reg.writeCookie != cookie) { continue; }
+                if (!(cqe.flags & IORING_CQE_F_MORE)) { reg.writeArmed = false; }
+            }
+
+            if (cqe.res < 0) {
+                if (cqe.res == -ECANCELED) { continue; }
+                ERROR("Error on fd: " << fd << " " << ::strerror(-cqe.res));
+            }
+
+            if (kind == READ) {
+                reg.readHandler->handleRead(fd);
+            }
+            else {
+                reg.writeHandler->handleWrite(fd);
+            }
+
+            rearm(fd);
+        }
+    }
+
+    // I_Selector implementation:
+
+    void addReadable(int fd, I_ReadHandler * handler, bool edge = false) {
+        auto & reg = _regs[fd];
+        ASSERT(!reg.readHandler, "");
+        reg.readHandler = handler;
+        reg.readCookie  = _nextCookie++;
+        reg.edge        = edge;
+        rearm(fd);
+    }
+
+    void removeReadable(int fd) {
+        auto iter = _regs.find(fd);
+        ASSERT(iter != _regs.end() && iter->second.readHandler, "");
+        auto & reg = iter->second;
+        if (reg.readArmed) { cancel(fd, READ, reg.readCookie); }
+        reg.readHandler = nullptr;
+        reg.readArmed   = false;
+        reg.edge        = false;
+        if (!reg.writeHandler) { _regs.erase(iter); }
+    }
+
+    void addWriteable(int fd, I_WriteHandler * handler) {
+        auto & reg = _regs[fd];
+        ASSERT(!reg.writeHandler, "");
+        reg.writeHandler = handler;
+        reg.writeCookie  = _nextCookie++;
+        rearm(fd);
+    }
+
+    void removeWriteable(int fd) {
+        auto iter = _regs.find(fd);
+        ASSERT(iter != _regs.end() && iter->second.writeHandler, "");
+        auto & reg = iter->second;
+        if (reg.writeArmed) { cancel(fd, WRITE, reg.writeCookie); }
+        reg.writeHandler = nullptr;
+        reg.writeArmed   = false;
+        if (!reg.readHandler) { _regs.erase(iter); }
+    }
+
+    int addTimer(I_TimerHandler * handler, uint32_t milliseconds, bool periodic) {
+        return _timers.add(handler, milliseconds, periodic);
+    }
+
+    void armTimer(int timer, uint32_t milliseconds) {
+        _timers.arm(timer, milliseconds);
+    }
+
+    void removeTimer(int timer) {
+        _timers.remove(timer);
+    }
+
+protected:
+    static uint64_t userData(int fd, int kind, uint32_t cookie) {
+        return (static_cast<uint64_t>(cookie) << 32) | (static_cast<uint32_t>(fd) << 1) | kind;
+    }
+
+    // Queue polls for any interest in fd that isn't armed.
+    void rearm(int fd) {
+        auto iter = _regs.find(fd);
+        if (iter == _regs.end()) { return; }
+        auto & reg = iter->second;
+
+        if (reg.readHandler && !reg.readArmed) {
+            auto sqe = getSqe();
+            sqe->opcode        = IORING_OP_POLL_ADD;
+            sqe->fd            = fd;
+            sqe->poll32_events = POLLIN;
+            sqe->len           = reg.edge ? IORING_POLL_ADD_MULTI : 0;
+            sqe->user_data     = userData(fd, READ, reg.readCookie);
+            reg.readArmed = true;
+        }
+
+        if (reg.writeHandler && !reg.writeArmed) {
+            auto sqe = getSqe();
+            sqe->opcode        = IORING_OP_POLL_ADD;
+            sqe->fd            = fd;
+            sqe->poll32_events = POLLOUT;
+            sqe->user_data     = userData(fd, WRITE, reg.writeCookie);
+            reg.writeArmed = true;
+        }
+    }
+
+    void cancel(int fd, int kind, uint32_t cookie) {
+        auto sqe = getSqe();
+        sqe->opcode    = IORING_OP_POLL_REMOVE;
+        sqe->fd        = -1;
+        sqe->addr      = userData(fd, kind, cookie);
+        sqe->user_data = REMOVE_TAG;
+    }
+
+    // The caller fills in the entry. The kernel doesn't see it until the
+    // next enter(), by which time it's complete.
+    struct io_uring_sqe * getSqe() {
+        if (_sqFilled - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) == _sqMask + 1) {
+            // Full: submit without waiting.
+            ENFORCE_SYS(TEMP_FAILURE_RETRY(enter(0, 0)) != -1, "");
+        }
+
+        auto index = _sqFilled & _sqMask;
+        auto sqe   = &_sqes[index];
+        std::memset(sqe, 0, sizeof *sqe);
+        _sqArray[index] = index;
+        ++_sqFilled;
+        ++_pending;
+
+        return sqe;
+    }
+
+    // Publish the filled entries, then submit them.
+    long enter(unsigned minComplete, unsigned flags) {
+        __atomic_store_n(_sqTail, _sqFilled, __ATOMIC_RELEASE);
+
+        auto rval = ::syscall(__NR_io_uring_enter, _fd, _pending, minComplete,
+                              flags, nullptr, 0);
+        if (rval != -1) { _pending -= rval; }
+        return rval;
+    }
+
+    void unmap() {
+        if (_sqes != MAP_FAILED) { ::munmap(_sqes, _sqesBytes); }
+        if (_sqRing != MAP_FAILED) { ::munmap(_sqRing, _sqRingBytes); }
+    }
+};
+
+//
+// The event loop's selector: io_uring when asked for and available,
+// otherwise epoll.
+//
+
+class Selector : public I_Selector, protected Uncopyable {
+    URingSelector * _uringSelector;
+    EPollSelector * _epollSelector;
+    I_Selector    & _selector;
+
+    static URingSelector * openURing(bool tryURing) {
+        if (!tryURing) { return nullptr; }
+
+        try {
+            return new URingSelector;
+        }
+        catch (const URingSelector::Error & ex) {
+            WARNING(ex.message << " Falling back to epoll.");
+            return nullptr;
+        }
+    }
+
+public:
+    explicit Selector(bool tryURing = false) :
+        _uringSelector(openURing(tryURing)),
+        _epollSelector(_uringSelector ? nullptr : new EPollSelector),
+        _selector(_uringSelector ?
+                  static_cast<I_Selector &>(*_uringSelector) : *_epollSelector) {}
+
+    virtual ~Selector() {
+        delete _uringSelector;
+        delete _epollSelector;
+    }
+
+    bool isURing() const { return _uringSelector; }
+
+    void animate() {
+        if (_uringSelector) { _uringSelector->animate(); }
+        else                { _epollSelector->animate(); }
+    }
+
+    // I_Selector implementation:
+
+    void addReadable(int fd, I_ReadHandler * handler, bool edge = false) {
+        _selector.addReadable(fd, handler, edge);
+    }
+
+    void removeReadable(int fd) {
+        _selector.removeReadable(fd);
+    }
+
+    void addWriteable(int fd, I_WriteHandler * handler) {
+        _selector.addWriteable(fd, handler);
+    }
+
+    void removeWriteable(int fd) {
+        _selector.removeWriteable(fd);
+    }
+
+    int addTimer(I_TimerHandler * handler, uint32_t milliseconds, bool periodic) {
+        return _selector.addTimer(handler, milliseconds, periodic);
+    }
+
+    void armTimer(int timer, uint32_t milliseconds) {
+        _selector.armTimer(timer, milliseconds);
+    }
+
+    void removeTimer(int timer) {
+        _selector.removeTimer(timer);
+    }
+};
 
 #endif // SUPPORT__SELECTOR__HXX
@@ -0,0 +1,57 @@
+// vi:noai:sw=4
+
+#include "terminol/support/lz.hxx"
+#include "terminol/support/debug.hxx"
+
+#include <cstdlib>
+#include <string>
+
+void roundTrip(const std::vector<uint8_t> & data) {
+    std::vector<uint8_t> compressed;
+    lz::compress(data.data(), data.size(), compressed);
+
+    std::vector<uint8_t> decompressed(data.size());
+    ENFORCE(lz::decompress(compressed.data(), compressed.size(),
+                           decompressed.data(), decompressed.size()),
+            "Failed to decompress " << data.size() << " bytes");
+    ENFORCE(decompressed == data, "Mismatch for " << data.size() << " bytes");
+
+    // A wrong size must be caught.
+    std::vector<uint8_t> longer(data.size() + 1);
+    ENFORCE(!lz::decompress(compressed.data(), compressed.size(),
+                            longer.data(), longer.size()), "Size not checked");
+}
+
+std::vector<uint8_t> fromString(const std::string & str) {
+    return std::vector<uint8_t>(str.begin(), str.end());
+}
+
+int main() {
+    roundTrip(std::vector<uint8_t>());
+    roundTrip(fromString("a"));
+    roundTrip(fromString("abcd"));
+    roundTrip(fromString("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"));
+    roundTrip(fromString("the quick brown fox, the quick brown fox, the quick brown dog"));
+
+    // Long literal and match runs need the extra length bytes.
+    std::vector<uint8_t> data;
+    for (int i = 0; i != 1000; ++i) { data.push_back(random()); }
+    for (int i = 0; i != 5000; ++i) { data.push_back(data[i % 700]); }
+    roundTrip(data);
+
+    // Repetitive data must actually shrink.
+    std::vector<uint8_t> runs(64 * 1024, ' ');
+    std::vector<uint8_t> compressed;
+    lz::compress(runs.data(), runs.size(), compressed);
+    ENFORCE(compressed.size() < runs.size() / 64, "Poor compression: " << compressed.size());
+    roundTrip(runs);
+
+    // Random data.
+    for (int n = 0; n != 100; ++n) {
+        std::vector<uint8_t> rnd(random() % 4096);
+        for (auto & b : rnd) { b = random() % 4; }
+        roundTrip(rnd);
+    }
+
+    return 0;
+}
@@ -2,6 +2,7 @@
 
 #include "terminol/support/debug.hxx"
 #include "terminol/support/conv.hxx"
+#include "terminol/support/time.hxx"
 
 void test1() {
     std::vector<std::string> tokens;
@@ -51,6 +52,44 @@ void test2(uint8_t num, const char ascii[2]) {
     }
 }
 
+void test3() {
+    try {
+        ENFORCE(unhumanSize("0") == 0, "");
+        ENFORCE(unhumanSize("512") == 512, "");
+        ENFORCE(unhumanSize("64K") == 64 * 1024, "");
+        ENFORCE(unhumanSize("64KB") == 64 * 1024, "");
+        ENFORCE(unhumanSize("3M") == 3 * 1024 * 1024, "");
+        ENFORCE(unhumanSize("2G") == size_t(2) * 1024 * 1024 * 1024, "");
+        ENFORCE(unhumanSize(humanSize(5 * 1024 * 1024)) == 5 * 1024 * 1024, "");
+    }
+    catch (const ParseError & ex) {
+        FATAL(ex.message);
+    }
+
+    for (auto bad : { "12Q", "-1", " -1K", "99999999999999999999", "17179869184G" }) {
+        try {
+            unhumanSize(bad);
+            FATAL("Accepted: " << bad);
+        }
+        catch (const ParseError &) {
+        }
+    }
+}
+
+void test4() {
+    LatencyRecorder recorder;
+
+    std::ostringstream ost1;
+    recorder.summarise(ost1);
+    ENFORCE(ost1.str() == "n=0", ost1.str());
+
+    for (uint64_t i = 1; i <= 100; ++i) { recorder.record(i * 1000); }
+
+    std::ostringstream ost2;
+    recorder.summarise(ost2);
+    ENFORCE(ost2.str() == "n=100 p50=50.0ms p90=90.0ms p99=99.0ms max=100.0ms", ost2.str());
+}
+
 int main() {
     test1();
 
@@ -58,5 +97,9 @@ int main() {
     test2(255, "FF");
     test2(127, "7F");
 
+    test3();
+
+    test4();
+
     return 0;
 }
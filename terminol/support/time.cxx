@@ -3,7 +3,12 @@
 #include "terminol/support/time.hxx"
 #include "terminol/support/debug.hxx"
 
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
 #include <sys/time.h>
+#include <time.h>
 
 Timer::Timer(uint32_t milliseconds) {
     const uint32_t THOUSAND = 1000;
@@ -36,3 +41,40 @@ bool Timer::expired() const {
     return sec > _sec || (sec == _sec && usec >= _usec);
 }
 
+uint64_t monotonicMicroseconds() {
+    struct timespec ts;
+    ENFORCE(::clock_gettime(CLOCK_MONOTONIC, &ts) == 0, "");
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void LatencyRecorder::record(uint64_t microseconds) {
+    auto sample = static_cast<uint32_t>(std::min<uint64_t>(microseconds, UINT32_MAX));
+
+    if (_samples.size() < MAX_SAMPLES) {
+        _samples.push_back(sample);
+    }
+    else {
+        _samples[_next] = sample;
+        _next = (_next + 1) % MAX_SAMPLES;
+    }
+
+    ++_total;
+}
+
+void LatencyRecorder::summarise(std::ostream & ost) const {
+    ost << "n=" << _total;
+    if (_samples.empty()) { return; }
+
+    auto sorted = _samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    auto ms = [&](size_t permille) {
+        return sorted[(sorted.size() - 1) * permille / 1000] / 1000.0;
+    };
+
+    ost << std::fixed << std::setprecision(1)
+        << " p50=" << ms(500) << "ms"
+        << " p90=" << ms(900) << "ms"
+        << " p99=" << ms(990) << "ms"
+        << " max=" << ms(1000) << "ms";
+}
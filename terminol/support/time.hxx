@@ -4,6 +4,7 @@
 #define COMMON__TIME__HXX
 
 #include <iosfwd>
+#include <vector>
 
 #include <stdint.h>
 
@@ -80,4 +81,33 @@ public:
     bool expired() const;
 };
 
+//
+// Microseconds on the monotonic clock. Only good for ordering events and
+// measuring intervals.
+//
+
+uint64_t monotonicMicroseconds();
+
+//
+// Keeps the most recent latency samples and summarises their
+// distribution.
+//
+
+class LatencyRecorder {
+    static const size_t MAX_SAMPLES = 64 * 1024;
+
+    std::vector<uint32_t> _samples;     // microseconds
+    size_t                _next;        // once full, the oldest
+    size_t                _total;
+
+public:
+    LatencyRecorder() : _samples(), _next(0), _total(0) {}
+
+    void   record(uint64_t microseconds);
+    size_t getTotal() const { return _total; }
+
+    // e.g. "n=120 p50=1.2ms p90=2.5ms p99=7.0ms max=9.1ms"
+    void   summarise(std::ostream & ost) const;
+};
+
 #endif // COMMON__TIME__HXX
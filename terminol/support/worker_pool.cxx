@@ -0,0 +1,136 @@
+// vi:noai:sw=4
+
+#include "terminol/support/worker_pool.hxx"
+#include "terminol/support/debug.hxx"
+
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+WorkerPool::WorkerPool(I_Selector & selector, size_t threads) :
+    _selector(selector),
+    _fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+    _mutex(),
+    _workCond(),
+    _doneCond(),
+    _queued(),
+    _running(),
+    _done(),
+    _stopping(false),
+    _count(threads),
+    _threads()
+{
+    ENFORCE_SYS(_fd != -1, "::eventfd() failed.");
+
+    _selector.addReadable(_fd, this);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ASSERT(_queued.empty() && _running.empty() && _done.empty(), "");
+        _stopping = true;
+    }
+
+    _workCond.notify_all();
+    for (auto & thread : _threads) { thread.join(); }
+
+    _selector.removeReadable(_fd);
+    ENFORCE_SYS(::close(_fd) != -1, "");
+}
+
+void WorkerPool::start() {
+    ASSERT(_threads.empty(), "Already started.");
+
+    for (size_t i = 0; i != _count; ++i) {
+        _threads.push_back(std::thread([this] { work(); }));
+    }
+}
+
+void WorkerPool::submit(I_Job * job) {
+    ASSERT(!_threads.empty(), "");
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queued.push_back(job);
+    }
+
+    _workCond.notify_one();
+}
+
+void WorkerPool::finish(I_Job * job) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto iter = std::find(_queued.begin(), _queued.end(), job);
+
+    if (iter != _queued.end()) {
+        // Not started, quicker to do it ourselves.
+        _queued.erase(iter);
+        lock.unlock();
+        job->jobRun();
+    }
+    else {
+        _doneCond.wait(lock, [&] { return _running.find(job) == _running.end(); });
+
+        iter = std::find(_done.begin(), _done.end(), job);
+        if (iter == _done.end()) { return; }            // already delivered
+        _done.erase(iter);
+        lock.unlock();
+    }
+
+    job->jobDone();
+}
+
+void WorkerPool::work() {
+    for (;;) {
+        I_Job * job;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _workCond.wait(lock, [this] { return _stopping || !_queued.empty(); });
+            if (_stopping) { return; }
+            job = _queued.front();
+            _queued.pop_front();
+            _running.insert(job);
+        }
+
+        job->jobRun();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running.erase(job);
+            _done.push_back(job);
+        }
+
+        _doneCond.notify_all();
+
+        uint64_t one = 1;
+        ENFORCE_SYS(TEMP_FAILURE_RETRY(::write(_fd, &one, sizeof one)) == sizeof one, "");
+    }
+}
+
+// I_Selector::I_ReadHandler implementation:
+
+void WorkerPool::handleRead(int fd) throw () {
+    ASSERT(fd == _fd, "");
+
+    uint64_t count;
+    if (TEMP_FAILURE_RETRY(::read(_fd, &count, sizeof count)) == -1) {
+        ENFORCE_SYS(errno == EAGAIN, "");
+    }
+
+    // One at a time, a jobDone() may finish() another job.
+    for (;;) {
+        I_Job * job;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_done.empty()) { break; }
+            job = _done.front();
+            _done.pop_front();
+        }
+
+        job->jobDone();
+    }
+}
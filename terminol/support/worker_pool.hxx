@@ -0,0 +1,72 @@
+// vi:noai:sw=4
+
+#ifndef SUPPORT__WORKER_POOL__HXX
+#define SUPPORT__WORKER_POOL__HXX
+
+#include "terminol/support/selector.hxx"
+#include "terminol/support/pattern.hxx"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+//
+// A fixed set of threads that run jobs. A job's jobRun() happens on a
+// worker; its jobDone() happens afterwards on the thread that animates
+// the selector, which is told through an eventfd. A job is submitted at
+// most once at a time. finish() is for when the main thread can't wait:
+// it takes the job back (or waits for it) and calls jobDone() at once.
+// A pool of no threads is allowed, as a stand-in, but takes no jobs.
+// The threads only exist once start() is called: a fork (daemon()) must
+// come before that, as the child would have none.
+//
+
+class WorkerPool :
+    protected I_Selector::I_ReadHandler,
+    protected Uncopyable
+{
+public:
+    class I_Job {
+    public:
+        virtual void jobRun() throw () = 0;     // on a worker
+        virtual void jobDone() throw () = 0;    // on the main thread
+
+    protected:
+        ~I_Job() {}
+    };
+
+private:
+    I_Selector               & _selector;
+    int                        _fd;             // eventfd: workers -> main
+    std::mutex                 _mutex;
+    std::condition_variable    _workCond;
+    std::condition_variable    _doneCond;
+    std::deque<I_Job *>        _queued;
+    std::set<I_Job *>          _running;
+    std::deque<I_Job *>        _done;
+    bool                       _stopping;
+    size_t                     _count;
+    std::vector<std::thread>   _threads;        // empty until start()
+
+public:
+    WorkerPool(I_Selector & selector, size_t threads);
+    virtual ~WorkerPool();              // jobs must all be done
+
+    size_t getThreads() const { return _count; }
+
+    void start();
+    void submit(I_Job * job);           // once started
+    void finish(I_Job * job);           // no-op unless submitted
+
+protected:
+    void work();
+
+    // I_Selector::I_ReadHandler implementation:
+
+    void handleRead(int fd) throw ();
+};
+
+#endif // SUPPORT__WORKER_POOL__HXX
@@ -6,6 +6,7 @@
 #include <xkbcommon/xkbcommon-keysyms.h>
 
 #include <sstream>
+#include <vector>
 #include <cstdlib>
 #include <limits>
 
@@ -73,21 +74,39 @@ Basics::Basics() throw (Error) {
         throw Error("Failed to locate visual");
     }
 
+    //
+    // Send every request before waiting on any reply, so the round trips
+    // overlap: startup waits about as long as for one. The requests that
+    // have no reply go first; checking them later costs nothing once the
+    // replies that follow them are in.
+    //
+
+    // Sends GetKeyboardMapping, collected on first use.
     _keySymbols = xcb_key_symbols_alloc(_connection);
     if (!_keySymbols) {
         throw Error("Failed to load key symbols");
     }
     auto keySymbolsGuard = scopeGuard([&] { xcb_key_symbols_free(_keySymbols); });
 
-    _normalCursor = loadNormalCursor();
+    std::vector<Check> checks;
+
+    _normalCursor = requestNormalCursor(checks);
     auto normalCursorGuard = scopeGuard([&] { xcb_free_cursor(_connection, _normalCursor); });
 
-    _invisibleCursor = loadInvisibleCursor();
+    _invisibleCursor = requestInvisibleCursor(checks);
     auto invisibleCursorGuard = scopeGuard([&] { xcb_free_cursor(_connection, _invisibleCursor); });
 
-    if (xcb_ewmh_init_atoms_replies(&_ewmhConnection,
-                                    xcb_ewmh_init_atoms(_connection, &_ewmhConnection),
-                                    nullptr) == 0) {
+    auto ewmhCookies        = xcb_ewmh_init_atoms(_connection, &_ewmhConnection);
+    auto clipboardCookie    = internAtom("CLIPBOARD", true);
+    auto utf8StringCookie   = internAtom("UTF8_STRING", false);
+    auto targetsCookie      = internAtom("TARGETS", true);
+    auto wmProtocolsCookie  = internAtom("WM_PROTOCOLS", false);
+    auto wmDeleteCookie     = internAtom("WM_DELETE_WINDOW", false);
+    auto modmapCookie       = xcb_get_modifier_mapping(_connection);
+
+    // Now the replies.
+
+    if (xcb_ewmh_init_atoms_replies(&_ewmhConnection, ewmhCookies, nullptr) == 0) {
         throw Error("Failed to initialise EWMH atoms");
     }
     auto ewmhConnectionGuard =
@@ -95,23 +114,29 @@ Basics::Basics() throw (Error) {
 
     try {
         _atomPrimary        = XCB_ATOM_PRIMARY;
-        _atomClipboard      = lookupAtom("CLIPBOARD", true);
+        _atomClipboard      = atomReply(clipboardCookie, "CLIPBOARD");
         try {
-            _atomUtf8String = lookupAtom("UTF8_STRING", false);
+            _atomUtf8String = atomReply(utf8StringCookie, "UTF8_STRING");
         }
         catch (const NotFoundError & ex) {
             WARNING("No atom UTF8_STRING, falling back on STRING.");
             _atomUtf8String = XCB_ATOM_STRING;
         }
-        _atomTargets        = lookupAtom("TARGETS", true);
-        _atomWmProtocols    = lookupAtom("WM_PROTOCOLS", false);
-        _atomWmDeleteWindow = lookupAtom("WM_DELETE_WINDOW", false);
+        _atomTargets        = atomReply(targetsCookie, "TARGETS");
+        _atomWmProtocols    = atomReply(wmProtocolsCookie, "WM_PROTOCOLS");
+        _atomWmDeleteWindow = atomReply(wmDeleteCookie, "WM_DELETE_WINDOW");
     }
     catch (const NotFoundError & ex) {
         throw Error(ex.message);
     }
 
-    determineMasks();
+    determineMasks(modmapCookie);
+
+    for (auto & check : checks) {
+        if (xcb_request_failed(_connection, check.cookie, check.what)) {
+            throw Error(std::string("Failed to ") + check.what + ".");
+        }
+    }
 
     ewmhConnectionGuard.dismiss();
     invisibleCursorGuard.dismiss();
@@ -224,17 +249,19 @@ ModifierSet Basics::convertState(uint8_t state) const {
     return modifiers;
 }
 
-xcb_atom_t Basics::lookupAtom(const std::string & name,
-                              bool create) throw (NotFoundError, Error) {
-    auto cookie = xcb_intern_atom(_connection, create ? 0 : 1, name.length(), name.data());
-    auto reply  = xcb_intern_atom_reply(_connection, cookie, nullptr);
+xcb_intern_atom_cookie_t Basics::internAtom(const std::string & name, bool create) {
+    return xcb_intern_atom(_connection, create ? 0 : 1, name.length(), name.data());
+}
+
+xcb_atom_t Basics::atomReply(xcb_intern_atom_cookie_t cookie,
+                             const std::string      & name) throw (NotFoundError, Error) {
+    auto reply = xcb_intern_atom_reply(_connection, cookie, nullptr);
 
     if (reply) {
         auto atom = reply->atom;
         std::free(reply);
 
         if (atom == XCB_ATOM_NONE) {
-            ASSERT(!create, "");
             throw NotFoundError("Atom not found: " + name);
         }
         else {
@@ -246,7 +273,7 @@ xcb_atom_t Basics::lookupAtom(const std::string & name,
     }
 }
 
-xcb_cursor_t Basics::loadNormalCursor() throw (Error) {
+xcb_cursor_t Basics::requestNormalCursor(std::vector<Check> & checks) {
     auto cursorId = 152;    // XC_xterm
 
     const std::string fontName = "cursor";
@@ -258,38 +285,34 @@ xcb_cursor_t Basics::loadNormalCursor() throw (Error) {
                                         font,
                                         fontName.size(),
                                         fontName.data());
-    if (xcb_request_failed(_connection, cookie, "can't open font")) {
-        throw Error("Failed to open font: " + fontName + ".");
-    }
-    auto guard  = scopeGuard([&] { xcb_close_font(_connection, font); });
+    checks.push_back({ cookie, "open cursor font" });
 
     // Create the cursor:
     auto cursor = xcb_generate_id(_connection);
     auto max    = std::numeric_limits<uint16_t>::max();
-    xcb_create_glyph_cursor_checked(_connection,
-                                    cursor,
-                                    font,
-                                    font,
-                                    cursorId,
-                                    cursorId + 1,
-                                    0, 0, 0, max / 2, max / 2, max / 2);
-    if (xcb_request_failed(_connection, cookie, "couldn't create cursor")) {
-        throw Error("Failed to create cursor.");
-    }
+    cookie = xcb_create_glyph_cursor_checked(_connection,
+                                             cursor,
+                                             font,
+                                             font,
+                                             cursorId,
+                                             cursorId + 1,
+                                             0, 0, 0, max / 2, max / 2, max / 2);
+    checks.push_back({ cookie, "create normal cursor" });
+
+    // The cursor keeps what it needs of the font.
+    xcb_close_font(_connection, font);
 
     return cursor;
 }
 
-xcb_cursor_t Basics::loadInvisibleCursor() throw (Error) {
+xcb_cursor_t Basics::requestInvisibleCursor(std::vector<Check> & checks) {
     auto pixmap = xcb_generate_id(_connection);
     auto cookie = xcb_create_pixmap_checked(_connection,
                                             1,
                                             pixmap,
                                             _screen->root,
                                             1, 1);
-    if (xcb_request_failed(_connection, cookie, "couldn't create pixmap")) {
-        throw Error("Failed to create pixmap.");
-    }
+    checks.push_back({ cookie, "create cursor pixmap" });
 
     auto cursor = xcb_generate_id(_connection);
     cookie = xcb_create_cursor_checked(_connection,
@@ -299,14 +322,12 @@ xcb_cursor_t Basics::loadInvisibleCursor() throw (Error) {
                                        0, 0, 0,
                                        0, 0, 0,
                                        1, 1);
-    if (xcb_request_failed(_connection, cookie, "couldn't create cursor")) {
-        throw Error("Failed to create cursor.");
-    }
+    checks.push_back({ cookie, "create invisible cursor" });
 
     return cursor;
 }
 
-void Basics::determineMasks() throw (Error) {
+void Basics::determineMasks(xcb_get_modifier_mapping_cookie_t cookie) throw (Error) {
     // Note, xcb_key_symbols_get_keycode() may return nullptr.
     auto shiftCodes      = xcb_key_symbols_get_keycode(_keySymbols, XKB_KEY_Shift_L);
     auto altCodes        = xcb_key_symbols_get_keycode(_keySymbols, XKB_KEY_Alt_L);
@@ -317,7 +338,6 @@ void Basics::determineMasks() throw (Error) {
     auto capsLockCodes   = xcb_key_symbols_get_keycode(_keySymbols, XKB_KEY_Caps_Lock);
     auto modeSwitchCodes = xcb_key_symbols_get_keycode(_keySymbols, XKB_KEY_Mode_switch);
 
-    auto cookie      = xcb_get_modifier_mapping(_connection);
     auto modmapReply = xcb_get_modifier_mapping_reply(_connection, cookie, nullptr);
     if (!modmapReply) {
         throw Error("Couldn't determine masks.");
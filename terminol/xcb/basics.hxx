@@ -7,6 +7,7 @@
 #include "terminol/common/bit_sets.hxx"
 
 #include <string>
+#include <vector>
 
 #include <xcb/xcb.h>
 #include <xcb/xcb_ewmh.h>
@@ -86,11 +87,17 @@ public:
     ModifierSet             convertState(uint8_t state) const;
 
 protected:
-    xcb_atom_t   lookupAtom(const std::string & name,
-                            bool create) throw (NotFoundError, Error);
-    xcb_cursor_t loadNormalCursor() throw (Error);
-    xcb_cursor_t loadInvisibleCursor() throw (Error);
-    void         determineMasks() throw (Error);
+    struct Check {          // a request whose error is collected later
+        xcb_void_cookie_t   cookie;
+        const char        * what;
+    };
+
+    xcb_intern_atom_cookie_t internAtom(const std::string & name, bool create);
+    xcb_atom_t   atomReply(xcb_intern_atom_cookie_t cookie,
+                           const std::string      & name) throw (NotFoundError, Error);
+    xcb_cursor_t requestNormalCursor(std::vector<Check> & checks);
+    xcb_cursor_t requestInvisibleCursor(std::vector<Check> & checks);
+    void         determineMasks(xcb_get_modifier_mapping_cookie_t cookie) throw (Error);
 };
 
 #endif // XCB__BASICS__HXX
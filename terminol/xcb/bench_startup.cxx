@@ -0,0 +1,176 @@
+// vi:noai:sw=4
+
+#include "terminol/support/conv.hxx"
+#include "terminol/support/debug.hxx"
+#include "terminol/support/pattern.hxx"
+#include "terminol/support/time.hxx"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <xcb/xcb.h>
+
+#include <unistd.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+// Cold start of a terminal: from running it to its window being mapped,
+// and to its first frame (the first time anything but the background
+// shows in the top rows). Run it under Xvfb, with no window manager:
+//
+//   Xvfb :9 & DISPLAY=:9 bench-startup 20 dist/bin/terminol
+//
+// For terminols, time the client against a running server:
+//
+//   bench-startup 20 dist/bin/terminolc
+
+namespace {
+
+const uint16_t STRIP_HEIGHT = 48;       // top rows, in pixels
+const uint64_t TIMEOUT_US   = 10000000;
+
+class Watcher : protected Uncopyable {
+    xcb_connection_t * _connection;
+    xcb_screen_t     * _screen;
+
+public:
+    Watcher() : _connection(nullptr), _screen(nullptr) {
+        _connection = xcb_connect(nullptr, nullptr);
+        ENFORCE(!xcb_connection_has_error(_connection), "Failed to connect to display.");
+        _screen = xcb_setup_roots_iterator(xcb_get_setup(_connection)).data;
+
+        // Top-level windows appear as children of the root.
+        uint32_t mask = XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY;
+        xcb_change_window_attributes(_connection, _screen->root, XCB_CW_EVENT_MASK, &mask);
+        xcb_flush(_connection);
+    }
+
+    ~Watcher() { xcb_disconnect(_connection); }
+
+    // Returns the next top-level window to be mapped.
+    xcb_window_t waitForMap(uint64_t start) {
+        for (;;) {
+            ENFORCE(monotonicMicroseconds() - start < TIMEOUT_US, "No window mapped.");
+            auto event = xcb_poll_for_event(_connection);
+            if (!event) { ::usleep(100); continue; }
+            auto guard = scopeGuard([event] { std::free(event); });
+
+            if ((event->response_type & ~0x80) == XCB_MAP_NOTIFY) {
+                auto e = reinterpret_cast<xcb_map_notify_event_t *>(event);
+                if (e->event == _screen->root) { return e->window; }
+            }
+        }
+    }
+
+    // Polls the top of the window until it isn't all one colour.
+    void waitForFrame(xcb_window_t window, uint64_t start) {
+        auto geometry = xcb_get_geometry_reply(_connection,
+                                               xcb_get_geometry(_connection, window),
+                                               nullptr);
+        ENFORCE(geometry, "Window went away.");
+        uint16_t width  = geometry->width;
+        uint16_t height = std::min(geometry->height, STRIP_HEIGHT);
+        std::free(geometry);
+
+        for (;;) {
+            ENFORCE(monotonicMicroseconds() - start < TIMEOUT_US, "No frame drawn.");
+
+            auto image = xcb_get_image_reply(_connection,
+                                             xcb_get_image(_connection, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                           window, 0, 0, width, height, ~0U),
+                                             nullptr);
+            if (image) {
+                auto guard  = scopeGuard([image] { std::free(image); });
+                auto data   = xcb_get_image_data(image);
+                auto length = xcb_get_image_data_length(image);
+                // 32 bits per pixel at the usual depths.
+                for (int i = 4; i + 4 <= length; i += 4) {
+                    if (std::memcmp(data + i, data, 4) != 0) { return; }
+                }
+            }
+
+            ::usleep(200);
+        }
+    }
+
+    // Drain the events left by the last run.
+    void drain() {
+        while (auto event = xcb_poll_for_event(_connection)) { std::free(event); }
+    }
+};
+
+pid_t launch(const std::vector<const char *> & args) {
+    posix_spawnattr_t attr;
+    ENFORCE(::posix_spawnattr_init(&attr) == 0, "");
+    // Its own process group, so the whole of it can be stopped.
+    ENFORCE(::posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP) == 0, "");
+    ENFORCE(::posix_spawnattr_setpgroup(&attr, 0) == 0, "");
+
+    pid_t pid;
+    auto  rval = ::posix_spawnp(&pid, args[0], nullptr, &attr,
+                                const_cast<char * const *>(&args.front()), environ);
+    ::posix_spawnattr_destroy(&attr);
+    ENFORCE(rval == 0, "Failed to run " << args[0] << ": " << ::strerror(rval));
+
+    return pid;
+}
+
+void stop(pid_t pid) {
+    ::kill(-pid, SIGTERM);
+    ENFORCE_SYS(::waitpid(pid, nullptr, 0) == pid, "");
+}
+
+double median(std::vector<uint64_t> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2] / 1e3;
+}
+
+} // namespace {anonymous}
+
+int main(int argc, char * argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " RUNS COMMAND [ARG]..." << std::endl;
+        return 1;
+    }
+
+    auto runs = unstringify<size_t>(argv[1]);
+    ENFORCE(runs != 0, "No runs.");
+    std::vector<const char *> args(argv + 2, argv + argc);
+    args.push_back(nullptr);
+
+    Watcher               watcher;
+    std::vector<uint64_t> mapped, drawn;
+
+    for (size_t i = 0; i != runs; ++i) {
+        watcher.drain();
+
+        auto t0     = monotonicMicroseconds();
+        auto pid    = launch(args);
+        auto window = watcher.waitForMap(t0);
+        auto t1     = monotonicMicroseconds();
+        watcher.waitForFrame(window, t0);
+        auto t2     = monotonicMicroseconds();
+
+        mapped.push_back(t1 - t0);
+        drawn.push_back(t2 - t0);
+
+        // A client (terminolc) has exited by now, its window lives on
+        // in the server: leave that to the server's shutdown.
+        if (::waitpid(pid, nullptr, WNOHANG) != pid) { stop(pid); }
+    }
+
+    std::cout
+        << std::fixed << std::setprecision(1)
+        << runs << " runs, median: "
+        << "mapped " << median(mapped) << " ms, "
+        << "first frame " << median(drawn) << " ms"
+        << std::endl;
+
+    return 0;
+}
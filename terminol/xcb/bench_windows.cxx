@@ -0,0 +1,123 @@
+// vi:noai:sw=4
+
+#include "terminol/common/control.hxx"
+#include "terminol/support/conv.hxx"
+#include "terminol/support/debug.hxx"
+#include "terminol/support/pattern.hxx"
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <set>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+// The CPU a terminols spends on many windows that are all streaming
+// output. The windows run COMMAND (default: yes) for a little longer
+// than the measurement, then go away. Use a server of its own and keep
+// the focus elsewhere; compare runs with background-frames-per-second
+// set to frames-per-second, and with the windows covered:
+//
+//   terminols --socket=/tmp/bench & bench-windows /tmp/bench 20 10
+
+namespace {
+
+control::Packet request(int fd, const control::Packet & packet) {
+    control::send(fd, packet);
+
+    control::Packet reply;
+    ENFORCE(control::receive(fd, reply), "Server hung up.");
+    auto outcome = reply.get<std::string>();
+    ENFORCE(outcome == "ok", reply.get<std::string>());
+
+    return reply;
+}
+
+// User plus system time of the whole process, all threads, in seconds.
+double cpuSeconds(pid_t pid) {
+    std::ifstream ifs("/proc/" + stringify(pid) + "/stat");
+    std::string   stat;
+    std::getline(ifs, stat);
+    ENFORCE(ifs, "Failed to read stat of " << pid);
+
+    // Skip the name, which may hold spaces, then state through stime.
+    std::istringstream ist(stat.substr(stat.rfind(')') + 2));
+    std::string        skip;
+    for (int i = 0; i != 11; ++i) { ist >> skip; }
+    unsigned long utime, stime;
+    ist >> utime >> stime;
+    ENFORCE(ist, "Bad stat of " << pid);
+
+    return static_cast<double>(utime + stime) / ::sysconf(_SC_CLK_TCK);
+}
+
+} // namespace {anonymous}
+
+int main(int argc, char * argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " SOCKET WINDOWS SECONDS [COMMAND]..." << std::endl;
+        return 1;
+    }
+
+    auto windows = unstringify<uint32_t>(argv[2]);
+    auto seconds = unstringify<unsigned>(argv[3]);
+    ENFORCE(windows != 0 && seconds != 0, "Nothing to measure.");
+
+    try {
+        auto fd    = control::connect(argv[1]);
+        auto guard = scopeGuard([fd] { ::close(fd); });
+
+        struct ucred cred;
+        socklen_t    length = sizeof cred;
+        ENFORCE_SYS(::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != -1, "");
+
+        control::Create create;
+        create.count   = windows;
+        create.command = { "timeout", stringify(seconds + 2) };
+        if (argc > 4) { create.command.insert(create.command.end(), argv + 4, argv + argc); }
+        else          { create.command.push_back("yes"); }
+
+        control::Packet packet;
+        packet.put("create");
+        control::put(packet, create);
+        auto reply   = request(fd, packet);
+        auto created = reply.get<size_t>();
+        ENFORCE(created == windows, "Created " << created << " of " << windows << " windows.");
+
+        std::set<uint32_t> ids;
+        for (size_t i = 0; i != created; ++i) { ids.insert(reply.get<uint32_t>()); }
+
+        auto cpu0 = cpuSeconds(cred.pid);
+        ::sleep(seconds);
+        auto cpu1 = cpuSeconds(cred.pid);
+
+        control::Packet statsPacket;
+        statsPacket.put("stats");
+        auto           statsReply = request(fd, statsPacket);
+        control::Stats stats;
+        control::get(statsReply, stats);
+
+        uint64_t parsed = 0, frames = 0;
+        for (auto & w : stats.windows) {
+            if (ids.find(w.id) != ids.end()) {
+                parsed += w.bytesParsed;
+                frames += w.framesDrawn;
+            }
+        }
+
+        std::cout
+            << std::fixed << std::setprecision(1)
+            << windows << " windows, " << seconds << " s: "
+            << "cpu " << 100.0 * (cpu1 - cpu0) / seconds << "%, "
+            << frames / static_cast<double>(seconds) << " frames/s, "
+            << parsed / (1024.0 * 1024.0 * seconds) << " MiB/s parsed"
+            << std::endl;
+    }
+    catch (const control::Error & ex) {
+        std::cerr << ex.message << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
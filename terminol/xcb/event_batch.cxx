@@ -0,0 +1,94 @@
+// vi:noai:sw=4
+
+#include "terminol/xcb/event_batch.hxx"
+
+#include <algorithm>
+#include <map>
+
+#include <cstdlib>
+
+#include <xcb/xcb_event.h>
+
+bool EventBatch::fill(xcb_connection_t * connection) {
+    clear();
+
+    while (auto event = ::xcb_poll_for_event(connection)) {
+        _events.push_back(event);
+    }
+
+    coalesce(_events);
+
+    return !_events.empty();
+}
+
+void EventBatch::clear() {
+    for (auto event : _events) { std::free(event); }
+    _events.clear();
+    _next = 0;
+}
+
+void EventBatch::coalesce(std::vector<xcb_generic_event_t *> & events) {
+    std::map<xcb_window_t, size_t> lastConfigure;
+    for (size_t i = 0; i != events.size(); ++i) {
+        if (XCB_EVENT_RESPONSE_TYPE(events[i]) == XCB_CONFIGURE_NOTIFY) {
+            auto e = reinterpret_cast<xcb_configure_notify_event_t *>(events[i]);
+            lastConfigure[e->window] = i;
+        }
+    }
+
+    std::map<xcb_window_t, size_t> series;      // -> the expose merged into so far
+
+    for (size_t i = 0; i != events.size(); ++i) {
+        auto event = events[i];
+        auto drop  = false;
+
+        switch (XCB_EVENT_RESPONSE_TYPE(event)) {
+            case XCB_MOTION_NOTIFY:
+                if (i + 1 != events.size() &&
+                    XCB_EVENT_RESPONSE_TYPE(events[i + 1]) == XCB_MOTION_NOTIFY)
+                {
+                    auto e    = reinterpret_cast<xcb_motion_notify_event_t *>(event);
+                    auto next = reinterpret_cast<xcb_motion_notify_event_t *>(events[i + 1]);
+                    drop = e->event == next->event && e->state == next->state;
+                }
+                break;
+            case XCB_EXPOSE: {
+                auto e    = reinterpret_cast<xcb_expose_event_t *>(event);
+                auto iter = series.find(e->window);
+
+                if (iter != series.end()) {
+                    auto prev = reinterpret_cast<xcb_expose_event_t *>(events[iter->second]);
+
+                    int x0 = std::min(e->x, prev->x);
+                    int y0 = std::min(e->y, prev->y);
+                    int x1 = std::max(e->x + e->width,  prev->x + prev->width);
+                    int y1 = std::max(e->y + e->height, prev->y + prev->height);
+
+                    e->x      = x0;
+                    e->y      = y0;
+                    e->width  = x1 - x0;
+                    e->height = y1 - y0;
+
+                    std::free(prev);
+                    events[iter->second] = nullptr;
+                }
+
+                if (e->count != 0) { series[e->window] = i; }
+                else if (iter != series.end()) { series.erase(iter); }
+                break;
+            }
+            case XCB_CONFIGURE_NOTIFY: {
+                auto e = reinterpret_cast<xcb_configure_notify_event_t *>(event);
+                drop = lastConfigure[e->window] != i;
+                break;
+            }
+        }
+
+        if (drop) {
+            std::free(event);
+            events[i] = nullptr;
+        }
+    }
+
+    events.erase(std::remove(events.begin(), events.end(), nullptr), events.end());
+}
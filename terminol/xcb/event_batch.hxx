@@ -0,0 +1,50 @@
+// vi:noai:sw=4
+
+#ifndef XCB__EVENT_BATCH__HXX
+#define XCB__EVENT_BATCH__HXX
+
+#include "terminol/support/pattern.hxx"
+
+#include <vector>
+
+#include <xcb/xcb.h>
+
+//
+// The X events queued on a connection, taken all at once and with the
+// redundant ones dropped before any is dispatched:
+//
+//  - A motion event followed directly by another for the same window
+//    and with the same state. Dragging a selection then moves it once
+//    per batch rather than once per pixel.
+//  - The exposes of a series (see the count field) for a window, which
+//    become one expose of their bounding box, at the end of the series.
+//  - A configure notify for a window that gets a later one.
+//
+// Everything else is kept, in the order it arrived. Whoever waits for an
+// event of their own mid-batch must take the rest of the batch first,
+// so as not to see newer events before older ones.
+//
+
+class EventBatch : protected Uncopyable {
+    std::vector<xcb_generic_event_t *> _events;
+    size_t                             _next;
+
+public:
+    EventBatch() : _events(), _next(0) {}
+    ~EventBatch() { clear(); }
+
+    // Replaces the batch with the events now queued. Returns false if
+    // there were none.
+    bool fill(xcb_connection_t * connection);
+
+    // The next event to dispatch, or nullptr. The batch keeps ownership.
+    xcb_generic_event_t * next() {
+        return _next != _events.size() ? _events[_next++] : nullptr;
+    }
+
+    void clear();
+
+    static void coalesce(std::vector<xcb_generic_event_t *> & events);
+};
+
+#endif // XCB__EVENT_BATCH__HXX
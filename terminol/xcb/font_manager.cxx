@@ -1,3 +1,41 @@
 // vi:noai:sw=4
 
 #include "terminol/xcb/font_manager.hxx"
+
+#include <sys/stat.h>
+
+namespace {
+
+uint32_t mix(uint32_t hash, uint64_t value) {
+    for (int i = 0; i != 8; ++i) {
+        hash ^= static_cast<uint8_t>(value >> (8 * i));
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+uint32_t mixTimes(uint32_t hash, FcStrList * list) {
+    if (!list) { return hash; }
+
+    while (auto path = ::FcStrListNext(list)) {
+        struct stat st;
+        if (::stat(reinterpret_cast<const char *>(path), &st) == 0) {
+            hash = mix(hash, st.st_mtim.tv_sec);
+            hash = mix(hash, st.st_mtim.tv_nsec);
+        }
+    }
+
+    ::FcStrListDone(list);
+    return hash;
+}
+
+} // namespace {anonymous}
+
+uint32_t FontManager::metricsGeneration() {
+    // Editing the configuration or rebuilding the caches (installing
+    // fonts) touches these, so stale metrics aren't trusted.
+    auto hash = mix(2166136261U, ::FcGetVersion());
+    hash = mixTimes(hash, ::FcConfigGetConfigFiles(nullptr));
+    hash = mixTimes(hash, ::FcConfigGetCacheDirs(nullptr));
+    return hash;
+}
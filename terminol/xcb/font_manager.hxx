@@ -5,12 +5,15 @@
 
 #include "terminol/xcb/font_set.hxx"
 #include "terminol/xcb/basics.hxx"
+#include "terminol/xcb/metrics_cache.hxx"
 #include "terminol/common/config.hxx"
 #include "terminol/support/pattern.hxx"
 
 #include <set>
 #include <map>
 
+#include <fontconfig/fontconfig.h>
+
 class FontManager : protected Uncopyable {
 public:
     class I_Client {
@@ -26,6 +29,7 @@ private:
     const Config             & _config;
     Basics                   & _basics;
 
+    MetricsCache               _metricsCache;
     int                        _delta;      // Global delta
     std::map<I_Client *, int>  _clients;
     std::map<int, FontSet *>   _fontSets;
@@ -35,12 +39,14 @@ public:
     FontManager(const Config & config, Basics & basics) throw (FontSet::Error) :
         _config(config),
         _basics(basics),
+        _metricsCache(config.cacheFontMetrics ? defaultMetricsCachePath() : std::string(),
+                      metricsGeneration()),
         _delta(0),
         _clients(),
         _fontSets(),
         _dispatch(false)
     {
-        auto fontSet = new FontSet(_config, _basics, _delta);
+        auto fontSet = new FontSet(_config, _basics, _metricsCache, _delta);
         _fontSets.insert(std::make_pair(_delta, fontSet));
         ASSERT(_fontSets.find(_delta) != _fontSets.end(), "");
     }
@@ -96,6 +102,10 @@ public:
     }
 
 protected:
+    // Keys the metrics cache to the fontconfig version, configuration
+    // and caches: changing any of them may change the fonts.
+    static uint32_t metricsGeneration();
+
     bool resizeClient(I_Client * client, int delta) {
         try {
             auto iter1 = _clients.find(client);
@@ -109,7 +119,7 @@ protected:
             auto dispatchGuard = scopeGuard([&] { _dispatch = false; });
 
             if (iter2 == _fontSets.end()) {
-                auto fontSet = new FontSet(_config, _basics, new_delta);
+                auto fontSet = new FontSet(_config, _basics, _metricsCache, new_delta);
                 _fontSets.insert(std::make_pair(new_delta, fontSet));
                 client->useFontSet(fontSet, new_delta);
             }
@@ -8,63 +8,49 @@
 
 FontSet::FontSet(const Config & config,
                  Basics       & basics,
+                 MetricsCache & metricsCache,
                  int            delta) throw (Error) :
     _config(config),
-    _basics(basics)
+    _basics(basics),
+    _metricsCache(metricsCache),
+    _name(_config.fontName),
+    _size(_config.fontSize + delta),
+    _normal(nullptr),
+    _bold(nullptr),
+    _italic(nullptr),
+    _italicBold(nullptr)
 {
-    auto & name = _config.fontName;
-    auto   size = _config.fontSize + delta;
+    if (_size <= 0) { throw Error("Too small"); }
 
-    if (size <= 0) { throw Error("Too small"); }
-
-    _normal = load(name, size, true, false, false);
-    auto normalGuard = scopeGuard([&] { unload(_normal); });
+    _normal = load(_name, _size, true, false, false);
+}
 
-    try {
-        _bold = load(name, size, false, true, false);
-    }
-    catch (const Error &) {
-        std::cerr << "Note, trying non-bold font" << std::endl;
-        _bold = load(name, size, false, false, false);
-    }
-    auto boldGuard = scopeGuard([&] { unload(_bold); });
+FontSet::~FontSet() {
+    if (_italicBold) { unload(_italicBold); }
+    if (_italic)     { unload(_italic); }
+    if (_bold)       { unload(_bold); }
+    unload(_normal);
+}
 
+// The normal font was good, so there's always something to fall back to.
+PangoFontDescription * FontSet::loadVariant(bool bold, bool italic) {
     try {
-        _italic = load(name, size, false, false, true);
-    }
-    catch (const Error &) {
-        std::cerr << "Note, trying non-italic font" << std::endl;
-        _italic = load(name, size, false, false, false);
+        return load(_name, _size, false, bold, italic);
     }
-    auto italicGuard = scopeGuard([&] { unload(_italic); });
+    catch (const Error &) {}
 
-    try {
-        _italicBold = load(name, size, false, true, true);
-    }
-    catch (const Error &) {
+    if (bold && italic) {
         std::cerr << "Note, trying non-bold, italic font" << std::endl;
         try {
-            _italicBold = load(name, size, false, false, true);
-        }
-        catch (const Error &) {
-            std::cerr << "Note, trying non-bold, non-italic font" << std::endl;
-            _italicBold = load(name, size, false, false, false);
+            return load(_name, _size, false, false, true);
         }
+        catch (const Error &) {}
     }
-    auto italicBoldGuard = scopeGuard([&] { unload(_italicBold); });
-
-    // Dismiss guards
-    italicBoldGuard.dismiss();
-    italicGuard.dismiss();
-    boldGuard.dismiss();
-    normalGuard.dismiss();
-}
 
-FontSet::~FontSet() {
-    unload(_italicBold);
-    unload(_italic);
-    unload(_bold);
-    unload(_normal);
+    std::cerr << "Note, trying "
+              << (bold ? "non-bold" : "") << (bold && italic ? ", " : "")
+              << (italic ? "non-italic" : "") << " font" << std::endl;
+    return load(_name, _size, false, false, false);
 }
 
 PangoFontDescription * FontSet::load(const std::string & family,
@@ -110,8 +96,14 @@ PangoFontDescription * FontSet::load(const std::string & family,
     std::free(str);
     */
 
-    uint16_t width, height;
-    measure(desc, width, height);
+    // Laying text out to measure it is the slow part of loading a font.
+    MetricsCache::Metrics metrics;
+    if (!_metricsCache.lookup(family, size, bold, italic, metrics)) {
+        measure(desc, metrics.width, metrics.height);
+        _metricsCache.store(family, size, bold, italic, metrics);
+    }
+    auto width  = metrics.width;
+    auto height = metrics.height;
 
     if (master) {
         // The master font (non-italic, non-bold) sets the precedence
@@ -4,6 +4,7 @@
 #define XCB__FONT_SET__HXX
 
 #include "terminol/xcb/basics.hxx"
+#include "terminol/xcb/metrics_cache.hxx"
 #include "terminol/common/config.hxx"
 #include "terminol/support/pattern.hxx"
 
@@ -12,11 +13,14 @@
 class FontSet : protected Uncopyable {
     const Config         & _config;
     Basics               & _basics;
+    MetricsCache         & _metricsCache;
 
+    std::string            _name;
+    int                    _size;
     PangoFontDescription * _normal;
-    PangoFontDescription * _bold;
-    PangoFontDescription * _italic;
-    PangoFontDescription * _italicBold;
+    PangoFontDescription * _bold;           // nullptr until first used
+    PangoFontDescription * _italic;         // ditto
+    PangoFontDescription * _italicBold;     // ditto
     uint16_t               _width;
     uint16_t               _height;
 
@@ -26,15 +30,19 @@ public:
         std::string message;
     };
 
-    FontSet(const Config & config, Basics & basics, int delta) throw (Error);
+    FontSet(const Config & config, Basics & basics, MetricsCache & metricsCache,
+            int delta) throw (Error);
     ~FontSet();
 
+    // The variants are loaded the first time they are asked for: most
+    // windows never show bold or italic text, and each costs a font
+    // lookup and a measurement at startup and on every zoom.
     PangoFontDescription * get(bool italic, bool bold) {
         switch ((italic ? 2 : 0) + (bold ? 1 : 0)) {
             case 0: return _normal;
-            case 1: return _bold;
-            case 2: return _italic;
-            case 3: return _italicBold;
+            case 1: if (!_bold)       { _bold       = loadVariant(true, false); } return _bold;
+            case 2: if (!_italic)     { _italic     = loadVariant(false, true); } return _italic;
+            case 3: if (!_italicBold) { _italicBold = loadVariant(true, true);  } return _italicBold;
         }
         FATAL("Unreachable");
     }
@@ -45,6 +53,7 @@ public:
 protected:
     PangoFontDescription * load(const std::string & family, int size, bool master,
                                 bool bold, bool italic) throw (Error);
+    PangoFontDescription * loadVariant(bool bold, bool italic);
     void unload(PangoFontDescription * desc);
 
     void measure(PangoFontDescription * desc, uint16_t & width, uint16_t & height);
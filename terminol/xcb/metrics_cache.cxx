@@ -0,0 +1,214 @@
+// vi:noai:sw=4
+
+#include "terminol/xcb/metrics_cache.hxx"
+#include "terminol/support/debug.hxx"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct MetricsCache::Header {
+    char     magic[8];
+    uint32_t generation;
+    uint32_t capacity;
+};
+
+struct MetricsCache::Entry {
+    uint32_t check;             // hash of the rest, 0 -> empty
+    int32_t  size;
+    uint8_t  bold;
+    uint8_t  italic;
+    uint16_t width;
+    uint16_t height;
+    uint16_t pad;
+    char     family[48];        // NUL padded
+};
+
+namespace {
+
+const char     MAGIC[8] = { 'T', 'R', 'M', 'L', 'M', 'T', 'C', '1' };
+const uint32_t CAPACITY = 256;
+const uint32_t PROBES   = 8;
+
+uint32_t fnv1a(const void * data, size_t size, uint32_t hash = 2166136261U) {
+    auto bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i != size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+template <typename E> uint32_t checkOf(const E & entry) {
+    auto hash = fnv1a(reinterpret_cast<const uint8_t *>(&entry) + sizeof entry.check,
+                      sizeof entry - sizeof entry.check);
+    return hash == 0 ? 1 : hash;
+}
+
+template <typename E> uint32_t slotOf(const E & entry) {
+    auto hash = fnv1a(entry.family, sizeof entry.family);
+    hash = fnv1a(&entry.size, sizeof entry.size, hash);
+    hash = fnv1a(&entry.bold, sizeof entry.bold, hash);
+    hash = fnv1a(&entry.italic, sizeof entry.italic, hash);
+    return hash % CAPACITY;
+}
+
+template <typename E> bool sameKey(const E & lhs, const E & rhs) {
+    return lhs.size == rhs.size && lhs.bold == rhs.bold && lhs.italic == rhs.italic &&
+        std::memcmp(lhs.family, rhs.family, sizeof lhs.family) == 0;
+}
+
+const size_t HEADER_BYTES = 16;
+const size_t FILE_BYTES   = HEADER_BYTES + CAPACITY * 64;
+
+} // namespace {anonymous}
+
+MetricsCache::MetricsCache(const std::string & path, uint32_t generation) :
+    _header(nullptr),
+    _entries(nullptr)
+{
+    static_assert(sizeof(Header) == HEADER_BYTES, "Header layout");
+    static_assert(sizeof(Entry) == 64, "Entry layout");
+
+    if (!path.empty()) { open(path, generation); }
+}
+
+MetricsCache::~MetricsCache() {
+    if (_header) {
+        ENFORCE_SYS(::munmap(_header, FILE_BYTES) != -1, "");
+    }
+}
+
+bool MetricsCache::lookup(const std::string & family, int size, bool bold, bool italic,
+                          Metrics & metrics) const {
+    Entry key;
+    if (!isOn() || !makeKey(family, size, bold, italic, key)) { return false; }
+
+    auto slot = slotOf(key);
+
+    for (uint32_t i = 0; i != PROBES; ++i) {
+        // Copied out before it's trusted: another process may be writing.
+        Entry entry;
+        std::memcpy(&entry, &_entries[(slot + i) % CAPACITY], sizeof entry);
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (entry.check != 0 && entry.check == checkOf(entry) && sameKey(entry, key)) {
+            metrics.width  = entry.width;
+            metrics.height = entry.height;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void MetricsCache::store(const std::string & family, int size, bool bold, bool italic,
+                         const Metrics & metrics) {
+    Entry entry;
+    if (!isOn() || !makeKey(family, size, bold, italic, entry)) { return; }
+
+    entry.width  = metrics.width;
+    entry.height = metrics.height;
+    entry.check  = checkOf(entry);
+
+    // Our own slot, else an empty one, else evict the first.
+    auto slot   = slotOf(entry);
+    auto target = &_entries[slot];
+
+    for (uint32_t i = 0; i != PROBES; ++i) {
+        auto candidate = &_entries[(slot + i) % CAPACITY];
+        if (candidate->check == 0 || sameKey(*candidate, entry)) {
+            target = candidate;
+            break;
+        }
+    }
+
+    // Readers see either no entry or a whole one.
+    target->check = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(reinterpret_cast<uint8_t *>(target) + sizeof entry.check,
+                reinterpret_cast<const uint8_t *>(&entry) + sizeof entry.check,
+                sizeof entry - sizeof entry.check);
+    std::atomic_thread_fence(std::memory_order_release);
+    target->check = entry.check;
+}
+
+void MetricsCache::open(const std::string & path, uint32_t generation) {
+    auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        WARNING("Font metrics not cached, failed to open: " << path);
+        return;
+    }
+    auto fdGuard = scopeGuard([fd] { ::close(fd); });
+
+    struct stat st;
+    ENFORCE_SYS(::fstat(fd, &st) != -1, "");
+
+    // Only ever grown: another terminols may have it mapped. What was
+    // there fails the header check below.
+    if (static_cast<size_t>(st.st_size) < FILE_BYTES) {
+        if (::ftruncate(fd, FILE_BYTES) == -1) {
+            WARNING("Font metrics not cached, failed to size: " << path);
+            return;
+        }
+    }
+
+    auto addr = ::mmap(nullptr, FILE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        WARNING("Font metrics not cached, failed to map: " << path);
+        return;
+    }
+
+    _header  = static_cast<Header *>(addr);
+    _entries = reinterpret_cast<Entry *>(static_cast<uint8_t *>(addr) + HEADER_BYTES);
+
+    if (std::memcmp(_header->magic, MAGIC, sizeof MAGIC) != 0 ||
+        _header->generation != generation ||
+        _header->capacity != CAPACITY)
+    {
+        // New, or from another fontconfig setup (whose fonts may differ).
+        std::memset(_entries, 0, CAPACITY * sizeof(Entry));
+        _header->generation = generation;
+        _header->capacity   = CAPACITY;
+        std::memcpy(_header->magic, MAGIC, sizeof MAGIC);
+    }
+}
+
+bool MetricsCache::makeKey(const std::string & family, int size, bool bold, bool italic,
+                           Entry & entry) const {
+    std::memset(&entry, 0, sizeof entry);
+
+    // Long names aren't worth truncating and risking a collision.
+    if (family.size() >= sizeof entry.family) { return false; }
+
+    family.copy(entry.family, family.size());
+    entry.size   = size;
+    entry.bold   = bold;
+    entry.italic = italic;
+
+    return true;
+}
+
+std::string defaultMetricsCachePath() {
+    std::string dir;
+
+    if (auto cacheHome = ::getenv("XDG_CACHE_HOME")) {
+        dir = cacheHome;
+    }
+    else if (auto home = ::getenv("HOME")) {
+        dir = std::string(home) + "/.cache";
+    }
+    else {
+        return std::string();
+    }
+
+    // Usually there already.
+    ::mkdir(dir.c_str(), 0700);
+
+    return dir + "/terminol-metrics";
+}
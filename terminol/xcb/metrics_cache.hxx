@@ -0,0 +1,57 @@
+// vi:noai:sw=4
+
+#ifndef XCB__METRICS_CACHE__HXX
+#define XCB__METRICS_CACHE__HXX
+
+#include "terminol/support/pattern.hxx"
+
+#include <string>
+
+#include <stdint.h>
+
+//
+// Cell sizes of fonts, kept across runs in a small memory-mapped file so
+// that startup and zooming don't have to lay text out to learn them. The
+// key is the family, pixel size and style; the whole file is for one
+// generation of the fonts (see FontManager) and is reset when that
+// changes (or when it doesn't look right). Sizes are absolute, in pixels,
+// so the DPI doesn't enter into it. Several terminols may share the file:
+// an entry carries a hash of itself and a torn one just reads as a miss.
+// The cache is best effort, it is simply off if the file can't be had.
+//
+
+class MetricsCache : protected Uncopyable {
+public:
+    struct Metrics {
+        uint16_t width;
+        uint16_t height;
+    };
+
+private:
+    struct Header;
+    struct Entry;
+
+    Header * _header;       // nullptr -> off
+    Entry  * _entries;
+
+public:
+    MetricsCache(const std::string & path, uint32_t generation);
+    ~MetricsCache();
+
+    bool isOn() const { return _header != nullptr; }
+
+    bool lookup(const std::string & family, int size, bool bold, bool italic,
+                Metrics & metrics) const;
+    void store(const std::string & family, int size, bool bold, bool italic,
+               const Metrics & metrics);
+
+protected:
+    void open(const std::string & path, uint32_t generation);
+    bool makeKey(const std::string & family, int size, bool bold, bool italic,
+                 Entry & entry) const;
+};
+
+// $XDG_CACHE_HOME/terminol-metrics, or under ~/.cache.
+std::string defaultMetricsCachePath();
+
+#endif // XCB__METRICS_CACHE__HXX
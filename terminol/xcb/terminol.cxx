@@ -4,7 +4,11 @@
 #include "terminol/xcb/color_set.hxx"
 #include "terminol/xcb/font_manager.hxx"
 #include "terminol/xcb/basics.hxx"
+#include "terminol/xcb/event_batch.hxx"
 #include "terminol/common/deduper.hxx"
+#include "terminol/common/chunk_deduper.hxx"
+#include "terminol/common/history_cooler.hxx"
+#include "terminol/common/frame_scheduler.hxx"
 #include "terminol/common/config.hxx"
 #include "terminol/common/parser.hxx"
 #include "terminol/common/key_map.hxx"
@@ -28,8 +32,13 @@ class EventLoop :
     protected Uncopyable
 {
     Selector           _selector;
-    Deduper            _deduper;
+    FrameScheduler     _frameScheduler;
+    Deduper            _lineDeduper;
+    ChunkDeduper       _chunkDeduper;
+    I_Deduper        & _deduper;
+    HistoryCooler      _historyCooler;
     Basics             _basics;
+    EventBatch         _batch;          // being dispatched
     ColorSet           _colorSet;
     FontManager        _fontManager;
     Window             _window;
@@ -45,15 +54,28 @@ public:
     EventLoop(const Config       & config,
               const Tty::Command & command)
         throw (Basics::Error, FontSet::Error, Window::Error, Error) :
-        _selector(),
-        _deduper(),
+        _selector(config.ioUring),
+        _frameScheduler(_selector, config.framesPerSecond,
+                        config.backgroundFramesPerSecond),
+        _lineDeduper(config.spillScrollBack && !config.compressScrollBack ?
+                     openSpillStore(config.spillDir) : nullptr,
+                     config.compressScrollBack,
+                     config.residentHistoryLines, config.residentHistorySeconds),
+        _chunkDeduper(),
+        _deduper(config.chunkedDedupe ?
+                 static_cast<I_Deduper &>(_chunkDeduper) : _lineDeduper),
+        _historyCooler(_selector, _deduper),
         _basics(),
+        _batch(),
         _colorSet(config, _basics),
         _fontManager(config, _basics),
         _window(*this,
                 config,
                 _selector,
                 _deduper,
+                _frameScheduler,
+                nullptr,        // one window, nothing to share the work with
+                nullptr,        // nor to start ahead of time
                 _basics,
                 _colorSet,
                 _fontManager,
@@ -77,15 +99,23 @@ protected:
             xevent();
 
             if (_deferral) { _window.deferral(); _deferral = false; }
+
+            // Soon move history that has gone cold out of the way.
+            _historyCooler.poke();
         }
     }
 
     void xevent() throw (Error) {
-        for (;;) {
-            auto event = ::xcb_poll_for_event(_basics.connection());
-            if (!event) { break; }
+        // Dispatching may queue more events, so go until there are none.
+        while (_batch.fill(_basics.connection())) { dispatchBatch(); }
 
-            auto guard        = scopeGuard([event] { std::free(event); });
+        if (xcb_connection_has_error(_basics.connection())) {
+            throw Error("Lost display connection.");
+        }
+    }
+
+    void dispatchBatch() {
+        while (auto event = _batch.next()) {
             auto responseType = XCB_EVENT_RESPONSE_TYPE(event);
 
             if (responseType == 0) {
@@ -95,10 +125,6 @@ protected:
                 dispatch(responseType, event);
             }
         }
-
-        if (xcb_connection_has_error(_basics.connection())) {
-            throw Error("Lost display connection.");
-        }
     }
 
     void dispatch(uint8_t responseType, xcb_generic_event_t * event) {
@@ -199,6 +225,9 @@ protected:
     // Window::I_Observer implementation:
 
     void windowSync() throw () {
+        // Older events first.
+        dispatchBatch();
+
         xcb_aux_sync(_basics.connection());
 
         for (;;) {
@@ -250,6 +279,7 @@ std::string makeHelp(const std::string & progName) {
         << "  --term=NAME" << std::endl
         << "  --trace" << std::endl
         << "  --sync" << std::endl
+        << "  --trace-latency" << std::endl
         ;
     return ost.str();
 }
@@ -265,6 +295,7 @@ int main(int argc, char * argv[]) {
     cmdLine.add(new IntHandler(config.fontSize),    '\0', "font-size");
     cmdLine.add(new BoolHandler(config.traceTty),   '\0', "trace");
     cmdLine.add(new BoolHandler(config.syncTty),    '\0', "sync");
+    cmdLine.add(new BoolHandler(config.traceLatency), '\0', "trace-latency");
     cmdLine.add(new StringHandler(config.termName), '\0', "term-name");
     cmdLine.add(new_MiscHandler([&](const std::string & name) { config.setColorScheme(name); }), '\0', "color-scheme");
 
@@ -1,75 +1,145 @@
 // vi:noai:sw=4
 
 #include "terminol/common/config.hxx"
+#include "terminol/common/control.hxx"
 #include "terminol/common/parser.hxx"
 #include "terminol/support/debug.hxx"
 #include "terminol/support/cmdline.hxx"
 
+#include <iostream>
+
 #include <unistd.h>
-#include <fcntl.h>
 
 namespace {
 
 std::string makeHelp(const std::string & progName) {
     std::ostringstream ost;
     ost << "terminolc " << VERSION << std::endl
-        << "Usage: " << progName << " [OPTION]..." << std::endl
+        << "Usage: " << progName << " [OPTION]... [--execute COMMAND]" << std::endl
         << std::endl
         << "Options:" << std::endl
         << "  --help" << std::endl
         << "  --socket=SOCKET" << std::endl
+        << "  --create=COUNT (default 1, unless --stats or --shutdown)" << std::endl
+        << "  --rows=ROWS" << std::endl
+        << "  --cols=COLS" << std::endl
+        << "  --cwd=DIR" << std::endl
+        << "  --env=NAME=VALUE (may be repeated)" << std::endl
+        << "  --stats" << std::endl
         << "  --shutdown" << std::endl
         ;
     return ost.str();
 }
 
+// Sends the request and returns the reply, past its "ok".
+control::Packet request(int fd, const control::Packet & packet) throw (control::Error) {
+    control::send(fd, packet);
+
+    control::Packet reply;
+    if (!control::receive(fd, reply)) {
+        throw control::Error("Server hung up.");
+    }
+
+    if (reply.get<std::string>() != "ok") {
+        throw control::Error(reply.get<std::string>());
+    }
+
+    return reply;
+}
+
+void printStats(const control::Stats & stats) {
+    std::cout
+        << "history: " << stats.uniqueLines << "/" << stats.totalLines << " lines unique, "
+        << stats.storedBytes << " bytes stored for " << stats.cellBytes << " bytes of cells"
+        << " (ratio " << (stats.storedBytes == 0 ? 0.0 :
+                          static_cast<double>(stats.cellBytes) / stats.storedBytes) << ")"
+        << std::endl;
+
+    std::cout << "window\tparsed\tframes\tlines\tbytes" << std::endl;
+    for (auto & w : stats.windows) {
+        std::cout
+            << w.id << '\t' << w.bytesParsed << '\t' << w.framesDrawn << '\t'
+            << w.historyLines << '\t' << w.historyBytes << std::endl;
+    }
+}
+
 } // namespace {anonymous}
 
 int main(int argc, char * argv[]) {
     Config config;
     parseConfig(config);
 
-    bool shutdown = false;
+    control::Create create;
+    uint32_t        count    = 0;
+    bool            stats    = false;
+    bool            shutdown = false;
 
-    CmdLine cmdLine(makeHelp(argv[0]), VERSION);
+    CmdLine cmdLine(makeHelp(argv[0]), VERSION, "--execute");
     cmdLine.add(new StringHandler(config.socketPath), '\0', "socket");
+    cmdLine.add(new IStreamHandler<uint32_t>(count), '\0', "create");
+    cmdLine.add(new IStreamHandler<uint16_t>(create.rows), '\0', "rows");
+    cmdLine.add(new IStreamHandler<uint16_t>(create.cols), '\0', "cols");
+    cmdLine.add(new StringHandler(create.options.cwd), '\0', "cwd");
+    cmdLine.add(new_MiscHandler([&](const std::string & value) {
+                                    create.options.env.push_back(value);
+                                }), '\0', "env");
+    cmdLine.add(new BoolHandler(stats), '\0', "stats");
     cmdLine.add(new BoolHandler(shutdown), '\0', "shutdown");
 
     // Command line
 
     try {
-        cmdLine.parse(argc, const_cast<const char **>(argv));
+        create.command = cmdLine.parse(argc, const_cast<const char **>(argv));
     }
     catch (const CmdLine::Error & ex) {
         FATAL(ex.message);
     }
 
-    const auto & socketPath = config.socketPath;
-    auto fd = ::open(socketPath.c_str(), O_WRONLY | O_NONBLOCK);
+    auto creating = count != 0 || (!stats && !shutdown);
+    if (count != 0) { create.count = count; }
 
-    if (fd == -1) {
-        std::cerr << "Failed to open: " << socketPath << std::endl;
-        return 1;
-    }
+    try {
+        auto fd    = control::connect(config.socketPath);
+        auto guard = scopeGuard([fd] { ::close(fd); });
+
+        if (creating) {
+            control::Packet packet;
+            packet.put("create");
+            control::put(packet, create);
+
+            auto reply = request(fd, packet);
+            auto created = reply.get<size_t>();
+            for (size_t i = 0; i != created; ++i) {
+                std::cout << reply.get<uint32_t>() << std::endl;
+            }
+
+            if (created != create.count) {
+                std::cerr << "Created " << created << " of " << create.count
+                          << " windows." << std::endl;
+                return 1;
+            }
+        }
+
+        if (stats) {
+            control::Packet packet;
+            packet.put("stats");
 
-    char c = shutdown ? 0xFF : 0;
-    auto rval = TEMP_FAILURE_RETRY(::write(fd, &c, 1));
-
-    if (rval == -1) {
-        switch (errno) {
-            case EAGAIN:
-                // The server does not have the socket open for
-                // read. Note, this can be caused by a race condition
-                // due to the el-cheapo FIFO scheme.
-                FATAL("Would block");
-                break;
-            default:
-                FATAL("");
-                break;
+            auto           reply = request(fd, packet);
+            control::Stats s;
+            control::get(reply, s);
+            printStats(s);
         }
-    }
 
-    ENFORCE_SYS(::close(fd) != -1, "");
+        if (shutdown) {
+            control::Packet packet;
+            packet.put("shutdown");
+            request(fd, packet);
+        }
+    }
+    catch (const control::Error & ex) {
+        std::cerr << ex.message << std::endl;
+        return 1;
+    }
 
     return 0;
 }
@@ -4,16 +4,25 @@
 #include "terminol/xcb/color_set.hxx"
 #include "terminol/xcb/font_manager.hxx"
 #include "terminol/xcb/basics.hxx"
+#include "terminol/xcb/event_batch.hxx"
 #include "terminol/common/deduper.hxx"
+#include "terminol/common/chunk_deduper.hxx"
+#include "terminol/common/locked_deduper.hxx"
+#include "terminol/common/history_cooler.hxx"
+#include "terminol/common/frame_scheduler.hxx"
+#include "terminol/common/shell_pool.hxx"
 #include "terminol/common/config.hxx"
+#include "terminol/common/control.hxx"
 #include "terminol/common/parser.hxx"
 #include "terminol/common/key_map.hxx"
 #include "terminol/support/selector.hxx"
+#include "terminol/support/worker_pool.hxx"
 #include "terminol/support/debug.hxx"
 #include "terminol/support/pattern.hxx"
 #include "terminol/support/cmdline.hxx"
 
 #include <set>
+#include <algorithm>
 
 #include <xcb/xcb.h>
 #include <xcb/xcb_event.h>
@@ -22,31 +31,39 @@
 #include <unistd.h>
 #include <sys/select.h>
 
-// For the server FIFO:
+// For the server socket:
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
-class I_Creator {
+class I_Controller {
 public:
-    virtual void create() throw () = 0;
+    // Returns the ids of the windows it managed to open; error says why
+    // the rest weren't.
+    virtual std::vector<uint32_t> create(const control::Create & create,
+                                         std::string           & error) throw () = 0;
+    virtual void stats(control::Stats & stats) throw () = 0;
     virtual void shutdown() throw () = 0;
 
 protected:
-    I_Creator() {}
-    ~I_Creator() {}
+    I_Controller() {}
+    ~I_Controller() {}
 };
 
 //
-// This server will ultimately be replaced with one based on
-// Unix domain sockets.
+// Serves the control protocol (see control.hxx) to terminolc, and to
+// scripts driving it, over a Unix domain socket. Only the user that
+// owns the server may connect.
 //
 
 class Server : protected I_Selector::I_ReadHandler {
-    I_Selector   & _selector;
-    I_Creator    & _creator;
-    const Config & _config;
-    int            _fd;
+    I_Selector     & _selector;
+    I_Controller   & _controller;
+    const Config   & _config;
+    int              _fd;
+    std::set<int>    _clients;
 
 public:
     struct Error {
@@ -54,92 +71,175 @@ public:
         std::string message;
     };
 
-    Server(I_Selector & selector, I_Creator & creator, const Config & config) throw (Error) :
+    Server(I_Selector & selector, I_Controller & controller, const Config & config) throw (Error) :
         _selector(selector),
-        _creator(creator),
+        _controller(controller),
         _config(config),
-        _fd(-1)
+        _fd(-1),
+        _clients()
     {
         auto & socketPath = _config.socketPath;
-        if (::mkfifo(socketPath.c_str(), 0600) == -1) {
-            switch (errno) {
-                case EEXIST:
-                    // No problem
-                    break;
-                default:
-                    throw Error("Failed to create fifo: " + socketPath);
+
+        struct sockaddr_un address;
+        std::memset(&address, 0, sizeof address);
+        address.sun_family = AF_UNIX;
+
+        if (socketPath.size() >= sizeof address.sun_path) {
+            throw Error("Socket path too long: " + socketPath);
+        }
+        socketPath.copy(address.sun_path, socketPath.size());
+
+        // Whatever is there is stale (or an old fifo) unless a server
+        // answers on it.
+        try {
+            ENFORCE_SYS(::close(control::connect(socketPath)) != -1, "");
+            throw Error("Already serving: " + socketPath);
+        }
+        catch (const control::Error & ex) {
+            if (::unlink(socketPath.c_str()) == -1 && errno != ENOENT) {
+                throw Error("Failed to unlink: " + socketPath);
             }
         }
 
-        open();
+        _fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        ENFORCE_SYS(_fd != -1, "::socket() failed.");
+        auto fdGuard = scopeGuard([&] { ::close(_fd); });
+
+        auto mask = ::umask(0077);
+        auto rval = ::bind(_fd, reinterpret_cast<struct sockaddr *>(&address), sizeof address);
+        ::umask(mask);
+
+        if (rval == -1 || ::listen(_fd, SOMAXCONN) == -1) {
+            throw Error("Failed to listen on: " + socketPath);
+        }
+
+        fdGuard.dismiss();
+        _selector.addReadable(_fd, this);
     }
 
     virtual ~Server() {
-        if (_fd != -1) {
-            close();
+        for (auto fd : _clients) {
+            _selector.removeReadable(fd);
+            ENFORCE_SYS(::close(fd) != -1, "");
         }
 
+        _selector.removeReadable(_fd);
+        ENFORCE_SYS(::close(_fd) != -1, "");
+
         auto & socketPath = _config.socketPath;
         if (::unlink(socketPath.c_str()) == -1) {
-            ERROR("Failed to unlink fifo: " << socketPath);
+            ERROR("Failed to unlink socket: " << socketPath);
         }
     }
 
 protected:
-    void reopen() {
-        close();
-
-        try {
-            open();
-        }
-        catch (const Error & ex) {
-            ERROR("Lost fifo");
+    void accept() {
+        auto fd = TEMP_FAILURE_RETRY(::accept4(_fd, nullptr, nullptr,
+                                               SOCK_NONBLOCK | SOCK_CLOEXEC));
+        if (fd == -1) {
+            ENFORCE_SYS(errno == EAGAIN || errno == ECONNABORTED, "::accept4() failed.");
+            return;
         }
-    }
 
-    void open() throw (Error) {
-        ASSERT(_fd == -1, "");
-        auto & socketPath = _config.socketPath;
+        // The socket may be somewhere others can reach, and a request
+        // can run any command.
+        struct ucred cred;
+        socklen_t    length = sizeof cred;
+        ENFORCE_SYS(::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != -1, "");
 
-        // Open non-blocking so we don't have to wait for the other
-        // end to open.
-        _fd = ::open(socketPath.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
-        if (_fd == -1) {
-            throw Error("Failed to open fifo: " + socketPath);
+        if (cred.uid != ::getuid()) {
+            ERROR("Refused client with uid: " << cred.uid);
+            ENFORCE_SYS(::close(fd) != -1, "");
+            return;
         }
-        _selector.addReadable(_fd, this);
+
+        _clients.insert(fd);
+        _selector.addReadable(fd, this);
     }
 
-    void close() {
-        ASSERT(_fd != -1, "");
-        _selector.removeReadable(_fd);
-        ENFORCE_SYS(::close(_fd) != -1, "::close() failed");
-        _fd = -1;
+    void disconnect(int fd) {
+        _selector.removeReadable(fd);
+        ENFORCE_SYS(::close(fd) != -1, "");
+        _clients.erase(fd);
     }
 
-    // I_Selector::I_ReadHandler implementation:
+    void serve(int fd) {
+        control::Packet request;
+        control::Packet reply;
+        bool            finished = false;
 
-    void handleRead(int fd) throw () {
-        ASSERT(_fd == fd, "");
+        try {
+            if (!control::receive(fd, request)) {
+                disconnect(fd);
+                return;
+            }
 
-        uint8_t buffer[1024];
-        auto    rval = TEMP_FAILURE_RETRY(::read(_fd, static_cast<void *>(buffer),
-                                                 sizeof buffer));
+            try {
+                auto name = request.get<std::string>();
 
-        ENFORCE_SYS(rval != -1, "::read() failed");
+                if (name == "create") {
+                    control::Create create;
+                    control::get(request, create);
 
-        if (rval == 0) {
-            reopen();
-        }
-        else {
-            ASSERT(rval > 0, "");
-            if (buffer[0] == 0xFF) {
-                _creator.shutdown();
+                    std::string error;
+                    auto ids = _controller.create(create, error);
+
+                    if (ids.empty() && create.count != 0) {
+                        reply.put("error").put(error);
+                    }
+                    else {
+                        reply.put("ok").put(ids.size());
+                        for (auto id : ids) { reply.put(id); }
+                    }
+                }
+                else if (name == "stats") {
+                    control::Stats stats;
+                    _controller.stats(stats);
+                    reply.put("ok");
+                    control::put(reply, stats);
+                }
+                else if (name == "shutdown") {
+                    reply.put("ok");
+                    finished = true;
+                }
+                else {
+                    reply.put("error").put("Unknown request: " + name);
+                }
             }
-            else {
-                _creator.create();
+            catch (const control::Error & ex) {
+                reply = control::Packet();
+                reply.put("error").put(ex.message);
+            }
+
+            try {
+                control::send(fd, reply);
+            }
+            catch (const control::Error & ex) {
+                // Most likely a stats reply for a great many windows.
+                control::Packet error;
+                error.put("error").put(ex.message);
+                control::send(fd, error);
             }
         }
+        catch (const control::Error & ex) {
+            ERROR("Dropping client: " << ex.message);
+            disconnect(fd);
+        }
+
+        // Last, once the reply has gone.
+        if (finished) { _controller.shutdown(); }
+    }
+
+    // I_Selector::I_ReadHandler implementation:
+
+    void handleRead(int fd) throw () {
+        if (fd == _fd) {
+            accept();
+        }
+        else {
+            ASSERT(_clients.find(fd) != _clients.end(), "");
+            serve(fd);
+        }
     }
 };
 
@@ -150,14 +250,22 @@ protected:
 class EventLoop :
     protected I_Selector::I_ReadHandler,
     protected Window::I_Observer,
-    protected I_Creator,
+    protected I_Controller,
     protected Uncopyable
 {
     const Config                     & _config;
     Selector                           _selector;
+    FrameScheduler                     _frameScheduler;
+    WorkerPool                         _workerPool;     // no threads unless emulation-threads
+    ShellPool                          _shellPool;      // empty unless shell-pool
     Server                             _server;         // FIXME what order? socket then X, or other way around?
-    Deduper                            _deduper;
+    Deduper                            _lineDeduper;
+    ChunkDeduper                       _chunkDeduper;
+    LockedDeduper                      _lockedDeduper;  // when the workers share it
+    I_Deduper                        & _deduper;
+    HistoryCooler                      _historyCooler;
     Basics                             _basics;
+    EventBatch                         _batch;          // being dispatched
     ColorSet                           _colorSet;
     FontManager                        _fontManager;
     std::map<xcb_window_t, Window *>   _windows;
@@ -174,10 +282,26 @@ public:
     explicit EventLoop(const Config & config)
         throw (Server::Error, Basics::Error, FontSet::Error, Error) :
         _config(config),
-        _selector(),
+        _selector(config.ioUring),
+        _frameScheduler(_selector, config.framesPerSecond,
+                        config.backgroundFramesPerSecond),
+        _workerPool(_selector, config.emulationThreads),
+        _shellPool(_selector, config),
         _server(_selector, *this, config),
-        _deduper(),
+        _lineDeduper(config.spillScrollBack && !config.compressScrollBack ?
+                     openSpillStore(config.spillDir) : nullptr,
+                     config.compressScrollBack,
+                     config.residentHistoryLines, config.residentHistorySeconds),
+        _chunkDeduper(),
+        _lockedDeduper(config.chunkedDedupe ?
+                       static_cast<I_Deduper &>(_chunkDeduper) : _lineDeduper),
+        _deduper(config.emulationThreads != 0 ?
+                 static_cast<I_Deduper &>(_lockedDeduper) :
+                 config.chunkedDedupe ?
+                 static_cast<I_Deduper &>(_chunkDeduper) : _lineDeduper),
+        _historyCooler(_selector, _deduper),
         _basics(),
+        _batch(),
         _colorSet(config, _basics),
         _fontManager(config, _basics),
         _windows(),
@@ -191,6 +315,9 @@ public:
             }
         }
 
+        // Only now, threads don't survive daemonising.
+        _workerPool.start();
+
         _selector.addReadable(_basics.fd(), this);
         loop();
         _selector.removeReadable(_basics.fd());
@@ -215,6 +342,11 @@ protected:
             for (auto window : _deferrals) { window->deferral(); }
             _deferrals.clear();
 
+            enforceGlobalHistoryLimit();
+
+            // Soon move history that has gone cold out of the way.
+            _historyCooler.poke();
+
             if (!_exits.empty()) {
                 // Purge the exited windows.
                 for (auto window : _exits) {
@@ -228,12 +360,47 @@ protected:
         }
     }
 
+    // The windows share one deduper and one history budget. While over
+    // budget, trim history from the least recently viewed or written
+    // windows first.
+    void enforceGlobalHistoryLimit() {
+        auto limit = _config.globalScrollBackBytes;
+        if (limit == 0 || _deduper.getBytes() <= limit) { return; }
+
+        std::vector<Window *> windows;
+        for (auto p : _windows) { windows.push_back(p.second); }
+
+        std::sort(windows.begin(), windows.end(),
+                  [](const Window * lhs, const Window * rhs) {
+                      return lhs->getLastActivity() < rhs->getLastActivity();
+                  });
+
+        for (auto window : windows) {
+            // A trim may free less than asked for (lines shared with other
+            // windows), so keep trimming this window while that pays. Once
+            // a trim frees nothing the rest of its history is likely held
+            // elsewhere too; move on rather than empty it for no gain.
+            while (_deduper.getBytes() > limit) {
+                auto before = _deduper.getBytes();
+                if (!window->trimHistory(before - limit) ||
+                    _deduper.getBytes() == before) { break; }
+            }
+
+            if (_deduper.getBytes() <= limit) { break; }
+        }
+    }
+
     void xevent() throw (Error) {
-        for (;;) {
-            auto event = ::xcb_poll_for_event(_basics.connection());
-            if (!event) { break; }
+        // Dispatching may queue more events, so go until there are none.
+        while (_batch.fill(_basics.connection())) { dispatchBatch(); }
 
-            auto guard        = scopeGuard([event] { std::free(event); });
+        if (xcb_connection_has_error(_basics.connection())) {
+            throw Error("Lost display connection.");
+        }
+    }
+
+    void dispatchBatch() {
+        while (auto event = _batch.next()) {
             auto responseType = XCB_EVENT_RESPONSE_TYPE(event);
 
             if (responseType == 0) {
@@ -243,10 +410,6 @@ protected:
                 dispatch(responseType, event);
             }
         }
-
-        if (xcb_connection_has_error(_basics.connection())) {
-            throw Error("Lost display connection.");
-        }
     }
 
     void dispatch(uint8_t responseType, xcb_generic_event_t * event) {
@@ -387,6 +550,9 @@ protected:
     // Window::I_Observer implementation:
 
     void windowSync() throw () {
+        // Older events first.
+        dispatchBatch();
+
         xcb_aux_sync(_basics.connection());
 
         for (;;) {
@@ -415,17 +581,52 @@ protected:
         _exits.push_back(window);
     }
 
-    // I_Creator implementation:
-
-    void create() throw () {
-        try {
-            auto window = new Window(*this, _config, _selector, _deduper,
-                                     _basics, _colorSet, _fontManager);
-            auto id = window->getWindowId();
-            _windows.insert(std::make_pair(id, window));
+    // I_Controller implementation:
+
+    std::vector<uint32_t> create(const control::Create & create,
+                                 std::string           & error) throw () {
+        std::vector<uint32_t> ids;
+
+        for (uint32_t i = 0; i != create.count; ++i) {
+            try {
+                auto window = new Window(*this, _config, _selector, _deduper, _frameScheduler,
+                                         _workerPool.getThreads() != 0 ? &_workerPool : nullptr,
+                                         &_shellPool,
+                                         _basics, _colorSet, _fontManager,
+                                         create.command, create.options,
+                                         create.rows, create.cols);
+                auto id = window->getWindowId();
+                _windows.insert(std::make_pair(id, window));
+                ids.push_back(id);
+            }
+            catch (const Window::Error & ex) {
+                PRINT("Failed to create window: " << ex.message);
+                error = ex.message;
+                break;
+            }
         }
-        catch (const Window::Error & ex) {
-            PRINT("Failed to create window: " << ex.message);
+
+        return ids;
+    }
+
+    void stats(control::Stats & stats) throw () {
+        _deduper.getStats(stats.uniqueLines, stats.totalLines);
+
+        size_t storedBytes, cellBytes;
+        _deduper.getStats2(storedBytes, cellBytes);
+        stats.storedBytes = storedBytes;
+        stats.cellBytes   = cellBytes;
+
+        stats.windows.clear();
+        for (auto p : _windows) {
+            auto window = p.second;
+            control::WindowStats w;
+            w.id           = p.first;
+            w.bytesParsed  = window->getBytesParsed();
+            w.framesDrawn  = window->getFramesDrawn();
+            w.historyLines = window->getHistoryLines();
+            w.historyBytes = window->getHistoryBytes();
+            stats.windows.push_back(w);
         }
     }
 
@@ -454,6 +655,7 @@ std::string makeHelp(const std::string & progName) {
         << "  --term=NAME" << std::endl
         << "  --trace|--no-trace" << std::endl
         << "  --sync|--no-sync" << std::endl
+        << "  --trace-latency|--no-trace-latency" << std::endl
         << "  --socket=SOCKET" << std::endl
         << "  --fork|--no-fork" << std::endl
         ;
@@ -470,6 +672,7 @@ int main(int argc, char * argv[]) {
     cmdLine.add(new IntHandler(config.fontSize),      '\0', "font-size");
     cmdLine.add(new BoolHandler(config.traceTty),     '\0', "trace");
     cmdLine.add(new BoolHandler(config.syncTty),      '\0', "sync");
+    cmdLine.add(new BoolHandler(config.traceLatency), '\0', "trace-latency");
     cmdLine.add(new StringHandler(config.termName),   '\0', "term-name");
     cmdLine.add(new StringHandler(config.socketPath), '\0', "socket");
     cmdLine.add(new BoolHandler(config.serverFork),   '\0', "fork");
@@ -477,6 +680,7 @@ int main(int argc, char * argv[]) {
 
     try {
         cmdLine.parse(argc, const_cast<const char **>(argv));
+
         EventLoop eventLoop(config);
     }
     catch (const EventLoop::Error & ex) {
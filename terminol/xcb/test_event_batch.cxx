@@ -0,0 +1,151 @@
+// vi:noai:sw=4
+
+#include "terminol/xcb/event_batch.hxx"
+#include "terminol/support/debug.hxx"
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include <xcb/xcb_event.h>
+
+namespace {
+
+// Zeroed and malloc'd, as the batch frees what it drops.
+template <typename E> E * make(uint8_t type) {
+    auto e = static_cast<E *>(std::calloc(1, sizeof(xcb_generic_event_t)));
+    static_assert(sizeof(E) <= sizeof(xcb_generic_event_t), "Event size");
+    e->response_type = type;
+    return e;
+}
+
+xcb_generic_event_t * motion(xcb_window_t window, uint16_t state, int16_t x) {
+    auto e = make<xcb_motion_notify_event_t>(XCB_MOTION_NOTIFY);
+    e->event   = window;
+    e->state   = state;
+    e->event_x = x;
+    return reinterpret_cast<xcb_generic_event_t *>(e);
+}
+
+xcb_generic_event_t * expose(xcb_window_t window,
+                             uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+                             uint16_t count) {
+    // The top bit marks a SendEvent and must not matter.
+    auto e = make<xcb_expose_event_t>(XCB_EXPOSE | 0x80);
+    e->window = window;
+    e->x      = x;
+    e->y      = y;
+    e->width  = width;
+    e->height = height;
+    e->count  = count;
+    return reinterpret_cast<xcb_generic_event_t *>(e);
+}
+
+xcb_generic_event_t * configure(xcb_window_t window, uint16_t width) {
+    auto e = make<xcb_configure_notify_event_t>(XCB_CONFIGURE_NOTIFY);
+    e->event  = window;
+    e->window = window;
+    e->width  = width;
+    return reinterpret_cast<xcb_generic_event_t *>(e);
+}
+
+xcb_generic_event_t * keyPress(xcb_window_t window) {
+    auto e = make<xcb_key_press_event_t>(XCB_KEY_PRESS);
+    e->event = window;
+    return reinterpret_cast<xcb_generic_event_t *>(e);
+}
+
+// Describes and frees the events, one per line.
+std::string describe(std::vector<xcb_generic_event_t *> & events) {
+    std::ostringstream ost;
+
+    for (auto event : events) {
+        switch (XCB_EVENT_RESPONSE_TYPE(event)) {
+            case XCB_MOTION_NOTIFY: {
+                auto e = reinterpret_cast<xcb_motion_notify_event_t *>(event);
+                ost << "motion " << e->event << " " << e->state << " " << e->event_x;
+                break;
+            }
+            case XCB_EXPOSE: {
+                auto e = reinterpret_cast<xcb_expose_event_t *>(event);
+                ost << "expose " << e->window << " " << e->x << "," << e->y << " "
+                    << e->width << "x" << e->height << " " << e->count;
+                break;
+            }
+            case XCB_CONFIGURE_NOTIFY: {
+                auto e = reinterpret_cast<xcb_configure_notify_event_t *>(event);
+                ost << "configure " << e->window << " " << e->width;
+                break;
+            }
+            case XCB_KEY_PRESS: {
+                auto e = reinterpret_cast<xcb_key_press_event_t *>(event);
+                ost << "key " << e->event;
+                break;
+            }
+            default:
+                FATAL("Unexpected event: " << int(event->response_type));
+        }
+        ost << std::endl;
+        std::free(event);
+    }
+
+    events.clear();
+    return ost.str();
+}
+
+void check(std::vector<xcb_generic_event_t *> events, const std::string & expected) {
+    EventBatch::coalesce(events);
+    auto actual = describe(events);
+    ENFORCE(actual == expected, "Expected:" << std::endl << expected <<
+            "Actual:" << std::endl << actual);
+}
+
+} // namespace {anonymous}
+
+int main() {
+    check({}, "");
+
+    // A run of motion keeps only its last event, per window and state.
+    check({ motion(1, 0, 1), motion(1, 0, 2), motion(1, 0, 3),
+            motion(1, 256, 4), motion(2, 256, 5),
+            keyPress(1),
+            motion(1, 256, 6) },
+          "motion 1 0 3\n"
+          "motion 1 256 4\n"
+          "motion 2 256 5\n"
+          "key 1\n"
+          "motion 1 256 6\n");
+
+    // A series of exposes becomes its bounding box, where the series ends.
+    // Another window's series is separate.
+    check({ expose(1, 10, 10, 5, 5, 2),
+            expose(2, 0, 0, 1, 1, 0),
+            expose(1, 0, 20, 5, 5, 1),
+            keyPress(1),
+            expose(1, 30, 0, 5, 5, 0),
+            expose(1, 1, 1, 1, 1, 1) },
+          "expose 2 0,0 1x1 0\n"
+          "key 1\n"
+          "expose 1 0,0 35x25 0\n"
+          "expose 1 1,1 1x1 1\n");
+
+    // Only a window's last configure is kept, in its place.
+    check({ configure(1, 100),
+            keyPress(2),
+            configure(2, 50),
+            configure(1, 200),
+            configure(2, 60) },
+          "key 2\n"
+          "configure 1 200\n"
+          "configure 2 60\n");
+
+    // Nothing to merge: all kept, in order.
+    check({ keyPress(1), motion(1, 0, 1), keyPress(2), motion(1, 0, 2), configure(1, 10) },
+          "key 1\n"
+          "motion 1 0 1\n"
+          "key 2\n"
+          "motion 1 0 2\n"
+          "configure 1 10\n");
+
+    return 0;
+}
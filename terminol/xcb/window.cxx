@@ -38,12 +38,19 @@ Window::Window(I_Observer         & observer,
                const Config       & config,
                I_Selector         & selector,
                I_Deduper          & deduper,
+               FrameScheduler     & frameScheduler,
+               WorkerPool         * workerPool,
+               ShellPool          * shellPool,
                Basics             & basics,
                const ColorSet     & colorSet,
                FontManager        & fontManager,
-               const Tty::Command & command) throw (Error) :
+               const Tty::Command & command,
+               const Tty::Options & options,
+               uint16_t             rows,
+               uint16_t             cols) throw (Error) :
     _observer(observer),
     _config(config),
+    _frameScheduler(frameScheduler),
     _basics(basics),
     _colorSet(colorSet),
     _fontManager(fontManager),
@@ -57,6 +64,8 @@ Window::Window(I_Observer         & observer,
     _open(false),
     _pointerPos(HPos::invalid()),
     _mapped(false),
+    _obscured(false),
+    _focused(false),
     _pixmapCurrent(false),
     _pixmap(0),
     _surface(nullptr),
@@ -73,14 +82,21 @@ Window::Window(I_Observer         & observer,
     _deferralsAllowed(true),
     _deferred(false),
     _transientTitle(false),
-    _hadDeleteRequest(false)
+    _hadDeleteRequest(false),
+    _lastKey(0),
+    _lastKeyTime(0),
+    _lastKeyReleased(true),
+    _inputPending(false),
+    _keyTime(0),
+    _echoLatency(),
+    _framesDrawn(0)
 {
     _fontSet = _fontManager.addClient(this);
     ASSERT(_fontSet, "");
     auto fontGuard = scopeGuard([&] { _fontManager.removeClient(this); });
 
-    auto rows = _config.initialRows;
-    auto cols = _config.initialCols;
+    if (rows == 0) { rows = _config.initialRows; }
+    if (cols == 0) { cols = _config.initialCols; }
 
     const auto BORDER_THICKNESS = _config.borderThickness;
     const auto SCROLLBAR_WIDTH  = _config.scrollbarWidth;
@@ -114,14 +130,19 @@ Window::Window(I_Observer         & observer,
         XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_LEAVE_WINDOW |
         XCB_EVENT_MASK_POINTER_MOTION_HINT | XCB_EVENT_MASK_POINTER_MOTION |
         XCB_EVENT_MASK_EXPOSURE |
+        XCB_EVENT_MASK_VISIBILITY_CHANGE |
         XCB_EVENT_MASK_STRUCTURE_NOTIFY |
         XCB_EVENT_MASK_FOCUS_CHANGE,
         // XCB_CW_CURSOR
         _basics.normalCursor()
     };
 
+    // The requests that create the window go out now, but they're only
+    // checked once the shell has been started: the round trip to the
+    // server overlaps with the spawn.
+
     _window = xcb_generate_id(_basics.connection());
-    cookie = xcb_create_window_checked(_basics.connection(),
+    auto windowCookie = xcb_create_window_checked(_basics.connection(),
                                        _basics.screen()->root_depth,
                                        _window,
                                        _basics.screen()->root,
@@ -138,9 +159,6 @@ Window::Window(I_Observer         & observer,
                                        XCB_CW_EVENT_MASK |
                                        XCB_CW_CURSOR,
                                        winValues);
-    if (xcb_request_failed(_basics.connection(), cookie, "Failed to create window")) {
-        throw Error("Failed to create window.");
-    }
 
     auto windowGuard = scopeGuard([&] {xcb_destroy_window(_basics.connection(), _window);});
 
@@ -159,14 +177,11 @@ Window::Window(I_Observer         & observer,
     };
 
     _gc = xcb_generate_id(_basics.connection());
-    cookie = xcb_create_gc_checked(_basics.connection(),
-                                   _gc,
-                                   _window,
-                                   XCB_GC_GRAPHICS_EXPOSURES,
-                                   gcValues);
-    if (xcb_request_failed(_basics.connection(), cookie, "Failed to allocate GC")) {
-        throw Error("Failed to create GC.");
-    }
+    auto gcCookie = xcb_create_gc_checked(_basics.connection(),
+                                          _gc,
+                                          _window,
+                                          XCB_GC_GRAPHICS_EXPOSURES,
+                                          gcValues);
 
     auto gcGuard = scopeGuard([&] { xcb_free_gc(_basics.connection(), _window); });
 
@@ -174,13 +189,27 @@ Window::Window(I_Observer         & observer,
     // Create the TTY and terminal.
     //
 
+    // So the server works on the window while the shell starts.
+    xcb_flush(_basics.connection());
+
     try {
-        _terminal = new Terminal(*this, _config, selector, deduper, rows, cols, stringify(_window), command);
+        _terminal = new Terminal(*this, _config, selector, deduper, workerPool, shellPool,
+                                 rows, cols, stringify(_window), command, options);
     }
     catch (const Tty::Error & ex) {
         throw Error("Failed to create tty: " + ex.message);
     }
 
+    auto terminalGuard = scopeGuard([&] { delete _terminal; });
+
+    if (xcb_request_failed(_basics.connection(), windowCookie, "Failed to create window")) {
+        throw Error("Failed to create window.");
+    }
+
+    if (xcb_request_failed(_basics.connection(), gcCookie, "Failed to allocate GC")) {
+        throw Error("Failed to create GC.");
+    }
+
     _open = true;
 
     //
@@ -196,6 +225,7 @@ Window::Window(I_Observer         & observer,
 
     xcb_flush(_basics.connection());
 
+    terminalGuard.dismiss();
     gcGuard.dismiss();
     windowGuard.dismiss();
     fontGuard.dismiss();
@@ -217,8 +247,16 @@ Window::~Window() {
         ASSERT(!_pixmap, "");
     }
 
+    if (_config.traceLatency) {
+        std::cerr << "Key press to present: ";
+        _echoLatency.summarise(std::cerr);
+        std::cerr << std::endl;
+    }
+
     // Unwind constructor.
 
+    _frameScheduler.remove(this);
+
     delete _terminal;
 
     xcb_free_gc(_basics.connection(), _gc);
@@ -239,13 +277,23 @@ Window::~Window() {
 void Window::keyPress(xcb_key_press_event_t * event) {
     cursorVisibility(false);
 
+    // X reports an auto-repeat as a release and a press of the same time.
+    auto repeat = event->detail == _lastKey &&
+        (!_lastKeyReleased || event->time == _lastKeyTime);
+    _lastKey         = event->detail;
+    _lastKeyTime     = event->time;
+    _lastKeyReleased = false;
+
     if (!_open) { return; }
 
     xcb_keysym_t keySym;
     ModifierSet  modifiers;
 
     if (_basics.getKeySym(event->detail, event->state, keySym, modifiers)) {
-        if (_terminal->keyPress(keySym, modifiers)) {
+        if (_terminal->keyPress(keySym, modifiers, repeat)) {
+            _inputPending = true;
+            if (_keyTime == 0) { _keyTime = monotonicMicroseconds(); }
+
             if (_hadDeleteRequest) {
                 _hadDeleteRequest = false;
             }
@@ -258,7 +306,12 @@ void Window::keyPress(xcb_key_press_event_t * event) {
     }
 }
 
-void Window::keyRelease(xcb_key_release_event_t * UNUSED(event)) {
+void Window::keyRelease(xcb_key_release_event_t * event) {
+    if (event->detail == _lastKey) {
+        _lastKeyTime     = event->time;
+        _lastKeyReleased = true;
+    }
+
     if (!_open) { return; }
 }
 
@@ -423,7 +476,8 @@ void Window::unmapNotify(xcb_unmap_notify_event_t * UNUSED(event)) {
     _pixmap = 0;
     _pixmapCurrent = false;
 
-    _mapped = false;
+    _mapped   = false;
+    _obscured = false;      // We'll be told again once mapped.
 }
 
 void Window::reparentNotify(xcb_reparent_notify_event_t * UNUSED(event)) {
@@ -483,10 +537,12 @@ void Window::configureNotify(xcb_configure_notify_event_t * event) {
 }
 
 void Window::focusIn(xcb_focus_in_event_t * UNUSED(event)) {
+    _focused = true;
     _terminal->focusChange(true);
 }
 
 void Window::focusOut(xcb_focus_out_event_t * UNUSED(event)) {
+    _focused = false;
     _terminal->focusChange(false);
 
 }
@@ -508,7 +564,20 @@ void Window::leaveNotify(xcb_leave_notify_event_t * event) {
     }
 }
 
-void Window::visibilityNotify(xcb_visibility_notify_event_t * UNUSED(event)) {
+void Window::visibilityNotify(xcb_visibility_notify_event_t * event) {
+    ASSERT(event->window == _window, "Which window?");
+
+    auto obscured = event->state == XCB_VISIBILITY_FULLY_OBSCURED;
+    if (obscured == _obscured) { return; }
+
+    _obscured = obscured;
+
+    // While covered, output only accumulates damage. Draw it all at once
+    // now; the exposes that follow copy from the up-to-date pixmap.
+    // Partially obscured windows draw as usual, the server clips the copy.
+    if (!_obscured && _mapped && _pixmapCurrent) {
+        _terminal->present();
+    }
 }
 
 void Window::destroyNotify(xcb_destroy_notify_event_t * event) {
@@ -850,6 +919,9 @@ void Window::draw() {
     cairo_destroy(_cr);
     _cr = nullptr;
 
+    _inputPending = false;
+    ++_framesDrawn;
+
     cairo_surface_flush(_surface);      // Useful?
     ENFORCE(cairo_surface_status(_surface) == CAIRO_STATUS_SUCCESS, "");
 }
@@ -902,21 +974,34 @@ void Window::drawBorder() {
     } cairo_restore(_cr);
 }
 
-void Window::copy(int x, int y, int w, int h) {
+void Window::copy(int x, int y, int w, int h, bool sync) {
     ASSERT(_mapped, "");
     ASSERT(_pixmap, "");
     ASSERT(_pixmapCurrent, "");
     // Copy the buffer region
-    auto cookie = xcb_copy_area_checked(_basics.connection(),
-                                        _pixmap,
-                                        _window,
-                                        _gc,
-                                        x, y,   // src
-                                        x, y,   // dst
-                                        w, h);
-    xcb_request_failed(_basics.connection(), cookie, "Failed to copy area");
-    //xcb_flush(_basics.connection());
-    xcb_aux_sync(_basics.connection());
+    if (sync) {
+        auto cookie = xcb_copy_area_checked(_basics.connection(),
+                                            _pixmap,
+                                            _window,
+                                            _gc,
+                                            x, y,   // src
+                                            x, y,   // dst
+                                            w, h);
+        xcb_request_failed(_basics.connection(), cookie, "Failed to copy area");
+        xcb_aux_sync(_basics.connection());
+    }
+    else {
+        // Checking would cost the round trip we're avoiding. An error
+        // comes back as an event instead.
+        xcb_copy_area(_basics.connection(),
+                      _pixmap,
+                      _window,
+                      _gc,
+                      x, y,     // src
+                      x, y,     // dst
+                      w, h);
+        xcb_flush(_basics.connection());
+    }
 }
 
 void Window::handleResize() {
@@ -1156,8 +1241,15 @@ void Window::terminalResizeBuffer(int16_t rows, int16_t cols) throw () {
     }
 }
 
+bool Window::terminalAdmitFrame() throw () {
+    // Nothing to show: keep the damage and don't take a frame tick.
+    if (_obscured) { return false; }
+
+    return _frameScheduler.admit(this, _inputPending, !_focused);
+}
+
 bool Window::terminalFixDamageBegin() throw () {
-    if (!_deferred && _mapped) {
+    if (!_deferred && _mapped && !_obscured) {
         ASSERT(_surface, "");
         _cr = cairo_create(_surface);
         cairo_set_line_width(_cr, 1.0);
@@ -1358,7 +1450,18 @@ void Window::terminalFixDamageEnd(const Region & damage,
         y1 = _height;
     }
 
-    copy(x0, y0, x1 - x0, y1 - y0);
+    // An echo only needs its own cells copied, and nothing is gained by
+    // waiting for the server to finish with them.
+    auto echo = _inputPending;
+    copy(x0, y0, x1 - x0, y1 - y0, !(echo && _config.lowLatencyEcho));
+
+    _inputPending = false;
+    ++_framesDrawn;
+
+    if (_keyTime != 0) {
+        _echoLatency.record(monotonicMicroseconds() - _keyTime);
+        _keyTime = 0;
+    }
 }
 
 void Window::terminalChildExited(int exitStatus) throw () {
@@ -1401,3 +1504,9 @@ void Window::useFontSet(FontSet * fontSet, int delta) throw () {
     _transientTitle = true;
     setTitle(ost.str());
 }
+
+// FrameScheduler::I_Client implementation:
+
+void Window::frameDue() throw () {
+    _terminal->present();
+}
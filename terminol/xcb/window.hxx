@@ -9,8 +9,10 @@
 #include "terminol/common/config.hxx"
 #include "terminol/common/key_map.hxx"
 #include "terminol/common/terminal.hxx"
+#include "terminol/common/frame_scheduler.hxx"
 #include "terminol/support/selector.hxx"
 #include "terminol/support/pattern.hxx"
+#include "terminol/support/time.hxx"
 
 #include <xcb/xcb.h>
 #include <xcb/xcb_keysyms.h>
@@ -20,6 +22,7 @@
 class Window :
     protected Terminal::I_Observer,
     protected FontManager::I_Client,
+    protected FrameScheduler::I_Client,
     protected Uncopyable
 {
 public:
@@ -37,6 +40,7 @@ public:
 private:
     I_Observer      & _observer;
     const Config    & _config;
+    FrameScheduler  & _frameScheduler;
     Basics          & _basics;
     const ColorSet  & _colorSet;
     FontManager     & _fontManager;
@@ -50,6 +54,8 @@ private:
     bool              _open;
     HPos              _pointerPos;
     bool              _mapped;          // Is the window mapped?
+    bool              _obscured;        // Is it fully covered? (damage accumulates)
+    bool              _focused;         // Otherwise it draws at the background rate
 
     bool              _pixmapCurrent;   // Is the pixmap up-to-date?
     xcb_pixmap_t      _pixmap;          // Created when mapped, destroyed when unmapped.
@@ -77,6 +83,15 @@ private:
     bool              _transientTitle;
     bool              _hadDeleteRequest;
 
+    xcb_keycode_t     _lastKey;         // Most recently pressed key.
+    xcb_timestamp_t   _lastKeyTime;     // Of its press, or its release.
+    bool              _lastKeyReleased;
+
+    bool              _inputPending;    // Key pressed since the last frame?
+    uint64_t          _keyTime;         // monotonicMicroseconds() of the first such
+    LatencyRecorder   _echoLatency;     // key press to present
+    uint64_t          _framesDrawn;     // whole or damage
+
 public:
     struct Error {
         explicit Error(const std::string & message_) : message(message_) {}
@@ -87,15 +102,31 @@ public:
            const Config       & config,
            I_Selector         & selector,
            I_Deduper          & deduper,
+           FrameScheduler     & frameScheduler,
+           WorkerPool         * workerPool,     // nullptr -> parse inline
+           ShellPool          * shellPool,      // nullptr -> start each shell afresh
            Basics             & basics,
            const ColorSet     & colorSet,
            FontManager        & fontManager,
-           const Tty::Command & command = Tty::Command()) throw (Error);
+           const Tty::Command & command = Tty::Command(),
+           const Tty::Options & options = Tty::Options(),
+           uint16_t             rows    = 0,        // 0 -> initial-rows
+           uint16_t             cols    = 0) throw (Error);
 
     virtual ~Window();
 
     xcb_window_t getWindowId() { return _window; }
 
+    size_t   getHistoryBytes() { return _terminal->getHistoryBytes(); }
+    uint64_t getLastActivity() const { return _terminal->getLastActivity(); }
+    bool     trimHistory(size_t bytes) { return _terminal->trimHistory(bytes); }
+
+    // Statistics:
+
+    uint64_t getBytesParsed()  const { return _terminal->getBytesParsed(); }
+    uint64_t getFramesDrawn()  const { return _framesDrawn; }
+    uint32_t getHistoryLines() { return _terminal->getHistoryLines(); }
+
     // Events:
 
     void keyPress(xcb_key_press_event_t * event);
@@ -137,7 +168,7 @@ protected:
     void draw();
     void drawBorder();
 
-    void copy(int x, int y, int w, int h);
+    void copy(int x, int y, int w, int h, bool sync = true);
 
     void handleResize();
     void resizeToAccommodate(int16_t rows, int16_t cols);
@@ -160,6 +191,7 @@ protected:
     void terminalSetIconName(const std::string & str) throw ();
     void terminalBeep() throw ();
     void terminalResizeBuffer(int16_t rows, int16_t cols) throw ();
+    bool terminalAdmitFrame() throw ();
     bool terminalFixDamageBegin() throw ();
     void terminalDrawBg(Pos    pos,
                         UColor color,
@@ -189,6 +221,10 @@ protected:
 
     void useFontSet(FontSet * fontSet, int delta) throw ();
 
+    // FrameScheduler::I_Client implementation:
+
+    void frameDue() throw ();
+
 private:
     XColor getColor(const UColor & ucolor) const {
         switch (ucolor.type) {